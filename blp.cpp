@@ -1,277 +1,1536 @@
 #include "blp.h"
 #include "blp_internal.h"
-#include <squish.h>
-#include <FreeImage.h>
+#include "blp_kernels.h"
+#include "blp_threads.h"
+#include <limits.h>
 #include <string.h>
 #include <memory.h>
+#include <algorithm>
+#include <new>
+
+#ifndef _WIN32
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
 
 
 // Forward declaration of "internal" functions
-tBGRAPixel* blp1_convert_jpeg(uint8_t* pSrc, tBLP1Infos* pInfos, uint32_t size);
-tBGRAPixel* blp1_convert_paletted_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height);
-tBGRAPixel* blp1_convert_paletted_no_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height);
-tBGRAPixel* blp1_convert_paletted_separated_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_no_alpha(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_alpha1(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_alpha4(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_alpha8(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_raw_bgra(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_dxt(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height, int flags);
+bool blp_readHeader(const uint8_t* pBytes, size_t size, tInternalBLPInfos* pBLPInfos);
+bool blp_readInfos(const uint8_t* pBytes, size_t size, tInternalBLPInfos* pBLPInfos);
+tBLPInfos blp_processSourceWith(const tBLPSource* pSource, tInternalBLPContext* pContext);
+uint8_t* blp_reserve(tScratchBuffer* pBuffer, size_t size);
+uint8_t* blp_acquireScratch(tInternalBLPContext* pContext, tScratchSlot slot, size_t size);
+void blp_releaseScratch(tInternalBLPContext* pContext, void* pBuffer);
+bool blp1_convert_jpeg(const uint8_t* pSrc, tBLP1Infos* pInfos, uint32_t size, unsigned int scaleDenom, unsigned int width, unsigned int height, const tRegion* pRegion, const tRowSink* pSink);
+void blp_jpeg_release_cache();
+bool blp_convert_paletted(const uint8_t* pSrc, const tBGRAPixel* pPalette, tPaletteRowFunction rowFunction, unsigned int width, unsigned int height, const tRegion* pRegion, const tRowSink* pSink);
+bool blp2_convert_raw_bgra(const uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height, const tRegion* pRegion, const tRowSink* pSink);
+bool blp2_convert_dxt(const uint8_t* pSrc, tDXTRowFunction rowFunction, unsigned int blockSize, unsigned int width, unsigned int height, const tRegion* pRegion, const tRowSink* pSink);
+bool blp2_convert_dxt_averages(const uint8_t* pSrc, tDXTAverageFunction averageFunction, unsigned int blockSize, unsigned int nbBlocksX, unsigned int nbBlocksY, const tRegion* pRegion, const tRowSink* pSink);
+bool blp_convertFileMip(FILE* pFile, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom, const tRegion* pRegion,
+                        tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData);
+bool blp_convertMemoryMip(const void* pData, size_t size, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                          const tRegion* pRegion, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData);
+bool blp_convertSourceMip(const tBLPSource* pSource, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                          const tRegion* pRegion, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData);
+tBGRAPixel* blp_convertSourceAllMipsWith(const tBLPSource* pSource, tInternalBLPInfos* pBLPInfos, size_t* pOffsets);
+bool blp_convertMip(tInternalBLPInfos* pBLPInfos, const uint8_t* pSrc, uint32_t size, unsigned int mipLevel, unsigned int scale,
+                    const tRegion* pRegion, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData);
+tBGRAPixel* blp_convertAllMipsFrom(tInternalBLPInfos* pBLPInfos, const uint8_t* pData, uint32_t dataOffset, size_t size, size_t* pOffsets);
+unsigned int blp_checkMipLevel(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel);
+unsigned int blp_scaledMipLevel(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom, unsigned int* pDecoderScale);
+void blp_mipRange(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, uint32_t* pOffset, uint32_t* pLength);
+uint64_t blp_minimumMipSize(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel);
+tPixelRowFunction blp_pixelRowFunction(tBLPPixelFormat format);
+tMipDecoder blp_mipDecoder(tInternalBLPInfos* pBLPInfos);
+
+
+// A read-only view of a whole file
+struct tFileMapping
+{
+    const uint8_t* pData;
+    size_t         size;
+};
+
+bool blp_mapFile(FILE* pFile, tFileMapping* pMapping);
+void blp_unmapFile(tFileMapping* pMapping);
+size_t blp_fileSize(FILE* pFile);
+size_t blp_readAt(FILE* pFile, size_t offset, void* pDst, size_t size);
+tBLPSource blp_fileSource(FILE* pFile);
+tBLPSource blp_memorySource(const void* pData, size_t size);
+tBLPSource blp_openFileSource(FILE* pFile);
+void blp_closeFileSource(tBLPSource* pSource);
+
+
+// The allocator of the library (see blp_setAllocator())
+static tBLPAllocFunction allocFunction = 0;
+static tBLPFreeFunction  freeFunction = 0;
+static void*             pAllocatorUserData = 0;
+
+
+void blp_setAllocator(tBLPAllocFunction alloc, tBLPFreeFunction release, void* pUserData)
+{
+    // The memory kept by the library must be released by the allocator that
+    // allocated it: the caches are emptied, and the workers of the thread pool
+    // are restarted
+    unsigned int nbThreads = blp_nbPoolThreads();
+    size_t       minPixels = blp_poolMinPixels();
+
+    blp_releaseCaches();
+    blp_setNbThreads(1, minPixels);
+
+    allocFunction      = (alloc && release ? alloc : 0);
+    freeFunction       = (alloc && release ? release : 0);
+    pAllocatorUserData = (alloc && release ? pUserData : 0);
+
+    blp_setNbThreads(nbThreads, minPixels);
+}
+
+
+// The default allocator is compatible with delete[] (of arrays of tBGRAPixel,
+// uint8_t, ...), for the callers not using blp_free(). Empty buffers are still
+// allocated, so 0 always means out of memory.
+void* blp_allocate(size_t size)
+{
+    if (allocFunction)
+        return allocFunction(size > 0 ? size : 1, pAllocatorUserData);
+
+    return ::operator new[](size, std::nothrow);
+}
+
+
+void blp_free(void* pMemory)
+{
+    if (!pMemory)
+        return;
+
+    if (freeFunction)
+        freeFunction(pMemory, pAllocatorUserData);
+    else
+        ::operator delete[](pMemory);
+}
+
+
+void blp_releaseCaches()
+{
+    blp_jpeg_release_cache();
+}
+
+
+tBLPInfos blp_processFile(FILE* pFile)
+{
+    tBLPSource source = blp_openFileSource(pFile);
+    tBLPInfos blpInfos = blp_processSourceWith(&source, 0);
+    blp_closeFileSource(&source);
+
+    return blpInfos;
+}
+
+
+tBLPInfos blp_processFileInContext(tBLPContext context, FILE* pFile)
+{
+    tBLPSource source = blp_openFileSource(pFile);
+    tBLPInfos blpInfos = blp_processSourceWith(&source, static_cast<tInternalBLPContext*>(context));
+    blp_closeFileSource(&source);
+
+    return blpInfos;
+}
+
+
+tBLPInfos blp_processSource(const tBLPSource* pSource)
+{
+    return blp_processSourceWith(pSource, 0);
+}
+
+
+tBLPInfos blp_processSourceInContext(tBLPContext context, const tBLPSource* pSource)
+{
+    return blp_processSourceWith(pSource, static_cast<tInternalBLPContext*>(context));
+}
+
+
+// Size of the biggest header (palette included), but for the BLP1 files using
+// a JPEG header bigger than a palette
+static const size_t BLP_HEADER_SIZE = (sizeof(tBLP1Header) + 256 * sizeof(tBGRAPixel) > sizeof(tBLP2Header) ?
+                                       sizeof(tBLP1Header) + 256 * sizeof(tBGRAPixel) : sizeof(tBLP2Header));
+
+
+// 'pContext' may be 0. Only the header is read from the callbacks of the source
+// (in one read, unless a JPEG header doesn't fit in it).
+tBLPInfos blp_processSourceWith(const tBLPSource* pSource, tInternalBLPContext* pContext)
+{
+    if (pSource->pData)
+    {
+        return (pContext ? blp_processMemoryInContext(pContext, pSource->pData, pSource->dataSize) :
+                           blp_processMemory(pSource->pData, pSource->dataSize));
+    }
+
+    uint8_t buffer[BLP_HEADER_SIZE];
+    size_t size = pSource->readAt(pSource->pUserData, 0, buffer, sizeof(buffer));
+
+    const uint8_t* pBytes = buffer;
+    uint8_t* pScratch = 0;
+
+    const size_t jpegHeaderOffset = sizeof(tBLP1Header) + sizeof(uint32_t);
+
+    if ((size == sizeof(buffer)) && (strncmp((const char*) buffer, "BLP1", 4) == 0))
+    {
+        uint32_t type;
+        uint32_t jpegHeaderSize;
+        memcpy(&type, buffer + offsetof(tBLP1Header, type), sizeof(uint32_t));
+        memcpy(&jpegHeaderSize, buffer + sizeof(tBLP1Header), sizeof(uint32_t));
+
+        if ((type == 0) && (jpegHeaderSize > size - jpegHeaderOffset))
+        {
+            // Bigger than the data: let blp_readInfos() reject it
+            size = std::min(jpegHeaderOffset + size_t(jpegHeaderSize), std::max(pSource->size(pSource->pUserData), size));
+
+            pScratch = blp_acquireScratch(pContext, BLP_SCRATCH_SOURCE, size);
+            if (!pScratch)
+                return 0;
+
+            size = pSource->readAt(pSource->pUserData, 0, pScratch, size);
+            pBytes = pScratch;
+        }
+    }
+
+    tBLPInfos blpInfos = (pContext ? blp_processMemoryInContext(pContext, pBytes, size) :
+                                     blp_processMemory(pBytes, size));
+
+    if (pScratch)
+        blp_releaseScratch(pContext, pScratch);
+
+    return blpInfos;
+}
+
+
+tBLPInfos blp_processMemory(const void* pData, size_t size)
+{
+    if (!pData || (size < 4))
+        return 0;
+
+    tInternalBLPInfos* pBLPInfos = blp_allocateArray<tInternalBLPInfos>(1);
+    if (!pBLPInfos)
+        return 0;
+
+    memset(pBLPInfos, 0, sizeof(tInternalBLPInfos));
+
+    if (!blp_readInfos(static_cast<const uint8_t*>(pData), size, pBLPInfos))
+    {
+        blp_free(pBLPInfos);
+        return 0;
+    }
+
+    return (tBLPInfos) pBLPInfos;
+}
+
+
+tBLPInfos blp_processMemoryInContext(tBLPContext context, const void* pData, size_t size)
+{
+    tInternalBLPContext* pContext = static_cast<tInternalBLPContext*>(context);
+
+    if (!pData || (size < 4))
+        return 0;
+
+    tInternalBLPInfos* pBLPInfos = &pContext->infos;
+    memset(pBLPInfos, 0, sizeof(tInternalBLPInfos));
+    pBLPInfos->pContext = pContext;
+
+    if (!blp_readInfos(static_cast<const uint8_t*>(pData), size, pBLPInfos))
+        return 0;
+
+    return (tBLPInfos) pBLPInfos;
+}
+
+
+// Reads the header, the palette and the JPEG header (stored in the context of
+// the structure, if any). The structure must be zeroed.
+bool blp_readInfos(const uint8_t* pBytes, size_t size, tInternalBLPInfos* pBLPInfos)
+{
+    if (!blp_readHeader(pBytes, size, pBLPInfos))
+        return false;
+
+    if (pBLPInfos->version == 2)
+    {
+        size_t offset = offsetof(tBLP2Header, palette);
+
+        if (size > offset)
+            memcpy(&pBLPInfos->blp2.palette, pBytes + offset, std::min(size - offset, sizeof(pBLPInfos->blp2.palette)));
+    }
+    else
+    {
+        size_t offset = sizeof(tBLP1Header);
+
+        if (pBLPInfos->blp1.header.type == 0)
+        {
+            pBLPInfos->blp1.infos.jpeg.headerSize = 0;
+            pBLPInfos->blp1.infos.jpeg.header = 0;
+
+            if (size >= offset + sizeof(uint32_t))
+                memcpy(&pBLPInfos->blp1.infos.jpeg.headerSize, pBytes + offset, sizeof(uint32_t));
+
+            offset += sizeof(uint32_t);
+
+            if (pBLPInfos->blp1.infos.jpeg.headerSize > size - std::min(size, offset))
+                return false;
+
+            if (pBLPInfos->blp1.infos.jpeg.headerSize > 0)
+            {
+                uint32_t headerSize = pBLPInfos->blp1.infos.jpeg.headerSize;
+
+                if (pBLPInfos->pContext)
+                    pBLPInfos->blp1.infos.jpeg.header = blp_reserve(&pBLPInfos->pContext->jpegHeader, headerSize);
+                else
+                    pBLPInfos->blp1.infos.jpeg.header = blp_allocateArray<uint8_t>(headerSize);
+
+                if (!pBLPInfos->blp1.infos.jpeg.header)
+                    return false;
+
+                memcpy(pBLPInfos->blp1.infos.jpeg.header, pBytes + offset, headerSize);
+            }
+        }
+        else if (size > offset)
+        {
+            memcpy(&pBLPInfos->blp1.infos.palette, pBytes + offset, std::min(size - offset, sizeof(pBLPInfos->blp1.infos.palette)));
+        }
+    }
+
+    pBLPInfos->decoder = blp_mipDecoder(pBLPInfos);
+
+    return true;
+}
+
+
+// Reads the fixed part of the header: everything but the palette of the BLP2
+// files, and the palette or JPEG header of the BLP1 files. Truncated headers are
+// zero-filled, like a short read would do (the structure must be zeroed). Files
+// without mip levels are rejected.
+bool blp_readHeader(const uint8_t* pBytes, size_t size, tInternalBLPInfos* pBLPInfos)
+{
+    if (size < 4)
+        return false;
+
+    if (strncmp((const char*) pBytes, "BLP2", 4) == 0)
+    {
+        pBLPInfos->version = 2;
+
+        memcpy(&pBLPInfos->blp2, pBytes, std::min(size, offsetof(tBLP2Header, palette)));
+
+        pBLPInfos->blp2.nbMipLevels = 0;
+        while ((pBLPInfos->blp2.nbMipLevels < 16) && (pBLPInfos->blp2.offsets[pBLPInfos->blp2.nbMipLevels] != 0))
+            ++pBLPInfos->blp2.nbMipLevels;
+    }
+    else if (strncmp((const char*) pBytes, "BLP1", 4) == 0)
+    {
+        pBLPInfos->version = 1;
+
+        memcpy(&pBLPInfos->blp1.header, pBytes, std::min(size, sizeof(tBLP1Header)));
+
+        pBLPInfos->blp1.infos.nbMipLevels = 0;
+        while ((pBLPInfos->blp1.infos.nbMipLevels < 16) && (pBLPInfos->blp1.header.offsets[pBLPInfos->blp1.infos.nbMipLevels] != 0))
+            ++pBLPInfos->blp1.infos.nbMipLevels;
+    }
+    else
+    {
+        return false;
+    }
+
+    // Without mip levels, there is nothing to convert (and the mip level
+    // requests couldn't be clamped to a valid one)
+    return (blp_nbMipLevels(pBLPInfos) > 0);
+}
+
+
+// Size of the biggest fixed part of a header
+static const size_t BLP_FIXED_HEADER_SIZE = (sizeof(tBLP1Header) > offsetof(tBLP2Header, palette) ?
+                                             sizeof(tBLP1Header) : offsetof(tBLP2Header, palette));
+
+
+bool blp_probe(FILE* pFile, tBLPProbe* pProbe)
+{
+    tBLPSource source = blp_fileSource(pFile);
+
+    return blp_probeSource(&source, pProbe);
+}
+
+
+bool blp_probeSource(const tBLPSource* pSource, tBLPProbe* pProbe)
+{
+    if (pSource->pData)
+        return blp_probeMemory(pSource->pData, pSource->dataSize, pProbe);
+
+    uint8_t buffer[BLP_FIXED_HEADER_SIZE];
+
+    size_t size = pSource->readAt(pSource->pUserData, 0, buffer, sizeof(buffer));
+
+    return blp_probeMemory(buffer, size, pProbe);
+}
+
+
+bool blp_probeMemory(const void* pData, size_t size, tBLPProbe* pProbe)
+{
+    tInternalBLPInfos infos;
+    memset(&infos, 0, sizeof(infos));
+
+    memset(pProbe, 0, sizeof(tBLPProbe));
+
+    if (!pData || !blp_readHeader(static_cast<const uint8_t*>(pData), size, &infos))
+        return false;
+
+    pProbe->version = infos.version;
+    pProbe->format  = blp_format(&infos);
+
+    if (infos.version == 2)
+    {
+        pProbe->width       = infos.blp2.width;
+        pProbe->height      = infos.blp2.height;
+        pProbe->nbMipLevels = infos.blp2.nbMipLevels;
+    }
+    else
+    {
+        pProbe->width       = infos.blp1.header.width;
+        pProbe->height      = infos.blp1.header.height;
+        pProbe->nbMipLevels = infos.blp1.infos.nbMipLevels;
+    }
+
+    return true;
+}
+
+
+size_t blp_probeFiles(const char* const* pPaths, size_t nbPaths, tBLPProbe* pProbes)
+{
+    size_t nbFound = 0;
+
+    for (size_t i = 0; i < nbPaths; ++i)
+    {
+        uint8_t buffer[BLP_FIXED_HEADER_SIZE];
+        size_t size = 0;
+
+#ifndef _WIN32
+        int fd = open(pPaths[i], O_RDONLY);
+        if (fd >= 0)
+        {
+            // Short reads of regular files only happen at their end
+            ssize_t nbRead;
+            do
+            {
+                nbRead = read(fd, buffer, sizeof(buffer));
+            }
+            while ((nbRead < 0) && (errno == EINTR));
+
+            size = (nbRead > 0 ? nbRead : 0);
+            close(fd);
+        }
+#else
+        FILE* pFile = fopen(pPaths[i], "rb");
+        if (pFile)
+        {
+            size = fread(buffer, sizeof(uint8_t), sizeof(buffer), pFile);
+            fclose(pFile);
+        }
+#endif
+
+        if (blp_probeMemory(buffer, size, &pProbes[i]))
+            ++nbFound;
+    }
+
+    return nbFound;
+}
+
+
+void blp_release(tBLPInfos blpInfos)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    // Owned by a context
+    if (pBLPInfos->pContext)
+        return;
+
+    if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.type == 0))
+        blp_free(pBLPInfos->blp1.infos.jpeg.header);
+
+    blp_free(pBLPInfos);
+}
+
+
+tBLPContext blp_createContext()
+{
+    tInternalBLPContext* pContext = blp_allocateArray<tInternalBLPContext>(1);
+
+    if (pContext)
+        memset(pContext, 0, sizeof(tInternalBLPContext));
+
+    return pContext;
+}
+
+
+void blp_releaseContext(tBLPContext context)
+{
+    tInternalBLPContext* pContext = static_cast<tInternalBLPContext*>(context);
+
+    if (!pContext)
+        return;
+
+    blp_free(pContext->jpegHeader.pData);
+
+    for (unsigned int i = 0; i < BLP_NB_SCRATCH_SLOTS; ++i)
+        blp_free(pContext->scratch[i].pData);
+
+    blp_free(pContext);
+}
+
+
+// Returns the data of the buffer, grown to at least 'size' bytes (0 when out of
+// memory). The previous content isn't kept.
+uint8_t* blp_reserve(tScratchBuffer* pBuffer, size_t size)
+{
+    if ((pBuffer->size < size) || !pBuffer->pData)
+    {
+        blp_free(pBuffer->pData);
+        pBuffer->pData = blp_allocateArray<uint8_t>(size);
+        pBuffer->size  = (pBuffer->pData ? size : 0);
+    }
+
+    return pBuffer->pData;
+}
+
+
+// Returns a buffer of 'size' bytes: a scratch buffer of the context, or a new
+// one without context (0 when out of memory). To give back to
+// blp_releaseScratch().
+uint8_t* blp_acquireScratch(tInternalBLPContext* pContext, tScratchSlot slot, size_t size)
+{
+    if (!pContext)
+        return blp_allocateArray<uint8_t>(size);
+
+    return blp_reserve(&pContext->scratch[slot], size);
+}
+
+
+void blp_releaseScratch(tInternalBLPContext* pContext, void* pBuffer)
+{
+    if (!pContext)
+        blp_free(pBuffer);
+}
+
+
+uint8_t blp_version(tBLPInfos blpInfos)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    return pBLPInfos->version;
+}
+
+
+tBLPFormat blp_format(tBLPInfos blpInfos)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    if (pBLPInfos->version == 2)
+    {
+        if (pBLPInfos->blp2.type == 0)
+            return BLP_FORMAT_JPEG;
+
+        if (pBLPInfos->blp2.encoding == BLP_ENCODING_UNCOMPRESSED)
+            return tBLPFormat((pBLPInfos->blp2.encoding << 16) | (pBLPInfos->blp2.alphaDepth << 8));
+
+        if (pBLPInfos->blp2.encoding == BLP_ENCODING_UNCOMPRESSED_RAW_BGRA)
+            return tBLPFormat((pBLPInfos->blp2.encoding << 16));
+
+        return tBLPFormat((pBLPInfos->blp2.encoding << 16) | (pBLPInfos->blp2.alphaDepth << 8) | pBLPInfos->blp2.alphaEncoding);
+    }
+    else
+    {
+        if (pBLPInfos->blp1.header.type == 0)
+            return BLP_FORMAT_JPEG;
+
+        if ((pBLPInfos->blp1.header.flags & 0x8) != 0)
+            return BLP_FORMAT_PALETTED_ALPHA_8;
+
+        return BLP_FORMAT_PALETTED_NO_ALPHA;
+    }
+}
+
+
+unsigned int blp_width(tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    if (pBLPInfos->version == 2)
+    {
+        // Check the mip level
+        if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
+            mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
+
+        return (pBLPInfos->blp2.width >> mipLevel);
+    }
+    else
+    {
+        // Check the mip level
+        if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
+            mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
+
+        return (pBLPInfos->blp1.header.width >> mipLevel);
+    }
+}
+
+
+unsigned int blp_height(tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    if (pBLPInfos->version == 2)
+    {
+        // Check the mip level
+        if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
+            mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
+
+        return (pBLPInfos->blp2.height >> mipLevel);
+    }
+    else
+    {
+        // Check the mip level
+        if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
+            mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
+
+        return (pBLPInfos->blp1.header.height >> mipLevel);
+    }
+}
+
+
+unsigned int blp_nbMipLevels(tBLPInfos blpInfos)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    if (pBLPInfos->version == 2)
+        return pBLPInfos->blp2.nbMipLevels;
+    else
+        return pBLPInfos->blp1.infos.nbMipLevels;
+}
+
+
+size_t blp_requiredBufferSize(tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    return size_t(blp_width(blpInfos, mipLevel)) * blp_height(blpInfos, mipLevel) * sizeof(tBGRAPixel);
+}
+
+
+tBGRAPixel* blp_convert(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    return blp_convertScaled(pFile, blpInfos, mipLevel, 1);
+}
+
+
+bool blp_convertInto(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, tBGRAPixel* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertScaledInto(pFile, blpInfos, mipLevel, 1, pDst, dstStride);
+}
+
+
+tBGRAPixel* blp_convertMemory(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    return blp_convertMemoryScaled(pData, size, blpInfos, mipLevel, 1);
+}
+
+
+bool blp_convertMemoryInto(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                           tBGRAPixel* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertMemoryScaledInto(pData, size, blpInfos, mipLevel, 1, pDst, dstStride);
+}
+
+
+void blp_scaledSize(tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom, unsigned int* pWidth, unsigned int* pHeight)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    unsigned int decoderScale;
+    mipLevel = blp_scaledMipLevel(pBLPInfos, mipLevel, scaleDenom, &decoderScale);
+
+    // Same rounding than libjpeg
+    *pWidth  = (blp_width(blpInfos, mipLevel) + decoderScale - 1) / decoderScale;
+    *pHeight = (blp_height(blpInfos, mipLevel) + decoderScale - 1) / decoderScale;
+}
+
+
+tBGRAPixel* blp_convertScaled(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom)
+{
+    unsigned int width;
+    unsigned int height;
+    blp_scaledSize(blpInfos, mipLevel, scaleDenom, &width, &height);
+
+    tBGRAPixel* pDst = blp_allocateArray<tBGRAPixel>(size_t(width) * height);
+
+    if (pDst && !blp_convertScaledInto(pFile, blpInfos, mipLevel, scaleDenom, pDst, 0))
+    {
+        blp_free(pDst);
+        return 0;
+    }
+
+    return pDst;
+}
+
+
+bool blp_convertScaledInto(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                           tBGRAPixel* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertToFormat(pFile, blpInfos, mipLevel, scaleDenom, BLP_PIXEL_FORMAT_BGRA, pDst, dstStride);
+}
+
+
+bool blp_convertToFormat(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                         tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertFileMip(pFile, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, scaleDenom, 0, format, pDst, dstStride, 0, 0);
+}
+
+
+bool blp_convertStream(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                       tBLPPixelFormat format, tBLPRowsCallback callback, void* pUserData)
+{
+    if (!callback)
+        return false;
+
+    return blp_convertFileMip(pFile, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, scaleDenom, 0, format, 0, 0, callback, pUserData);
+}
+
+
+tBGRAPixel* blp_convertMemoryScaled(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom)
+{
+    unsigned int width;
+    unsigned int height;
+    blp_scaledSize(blpInfos, mipLevel, scaleDenom, &width, &height);
+
+    tBGRAPixel* pDst = blp_allocateArray<tBGRAPixel>(size_t(width) * height);
+
+    if (pDst && !blp_convertMemoryScaledInto(pData, size, blpInfos, mipLevel, scaleDenom, pDst, 0))
+    {
+        blp_free(pDst);
+        return 0;
+    }
+
+    return pDst;
+}
+
+
+bool blp_convertMemoryScaledInto(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                                 tBGRAPixel* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertMemoryToFormat(pData, size, blpInfos, mipLevel, scaleDenom, BLP_PIXEL_FORMAT_BGRA, pDst, dstStride);
+}
+
+
+bool blp_convertMemoryToFormat(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                               tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertMemoryMip(pData, size, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, scaleDenom, 0, format, pDst, dstStride, 0, 0);
+}
+
+
+bool blp_convertMemoryStream(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                             tBLPPixelFormat format, tBLPRowsCallback callback, void* pUserData)
+{
+    if (!callback)
+        return false;
+
+    return blp_convertMemoryMip(pData, size, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, scaleDenom, 0, format, 0, 0, callback, pUserData);
+}
+
+
+bool blp_convertRegion(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel,
+                       unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                       tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride)
+{
+    tRegion region = { x, y, width, height };
+
+    return blp_convertFileMip(pFile, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, 1, &region, format, pDst, dstStride, 0, 0);
+}
+
+
+bool blp_convertMemoryRegion(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                             unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                             tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride)
+{
+    tRegion region = { x, y, width, height };
+
+    return blp_convertMemoryMip(pData, size, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, 1, &region, format, pDst, dstStride, 0, 0);
+}
+
+
+tBGRAPixel* blp_convertSource(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    tBGRAPixel* pDst = blp_allocateArray<tBGRAPixel>(blp_requiredBufferSize(blpInfos, mipLevel) / sizeof(tBGRAPixel));
+
+    if (pDst && !blp_convertSourceToFormat(pSource, blpInfos, mipLevel, 1, BLP_PIXEL_FORMAT_BGRA, pDst, 0))
+    {
+        blp_free(pDst);
+        return 0;
+    }
+
+    return pDst;
+}
+
+
+bool blp_convertSourceToFormat(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                               tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride)
+{
+    return blp_convertSourceMip(pSource, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, scaleDenom, 0, format, pDst, dstStride, 0, 0);
+}
+
+
+bool blp_convertSourceStream(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                             tBLPPixelFormat format, tBLPRowsCallback callback, void* pUserData)
+{
+    if (!callback)
+        return false;
+
+    return blp_convertSourceMip(pSource, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, scaleDenom, 0, format, 0, 0, callback, pUserData);
+}
+
+
+bool blp_convertSourceRegion(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel,
+                             unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                             tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride)
+{
+    tRegion region = { x, y, width, height };
+
+    return blp_convertSourceMip(pSource, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, 1, &region, format, pDst, dstStride, 0, 0);
+}
+
+
+const tBGRAPixel* blp_viewMemory(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel)
+{
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    if (blp_format(pBLPInfos) != BLP_FORMAT_RAW_BGRA)
+        return 0;
+
+    mipLevel = blp_checkMipLevel(pBLPInfos, mipLevel);
+
+    uint32_t offset;
+    uint32_t length;
+    blp_mipRange(pBLPInfos, mipLevel, &offset, &length);
+
+    // Like the conversions, the mip level is cut at the end of the buffer, and
+    // must still hold the whole image (whose size can exceed 32 bits)
+    if ((offset > size) || (uint64_t(std::min(size_t(length), size - offset)) < blp_minimumMipSize(pBLPInfos, mipLevel)))
+        return 0;
+
+    return reinterpret_cast<const tBGRAPixel*>(static_cast<const uint8_t*>(pData) + offset);
+}
+
+
+bool blp_map(FILE* pFile, tBLPMapping* pMapping)
+{
+    tFileMapping mapping;
+
+    pMapping->pBuffer = 0;
+
+    if (blp_mapFile(pFile, &mapping))
+    {
+        pMapping->pData = mapping.pData;
+        pMapping->size  = mapping.size;
+        return true;
+    }
+
+    // The file can't be mapped: read it entirely in memory
+    size_t size = blp_fileSize(pFile);
+    if (size == 0)
+        return false;
+
+    uint8_t* pBuffer = blp_allocateArray<uint8_t>(size);
+    if (!pBuffer)
+        return false;
+
+    pMapping->pData   = pBuffer;
+    pMapping->size    = blp_readAt(pFile, 0, pBuffer, size);
+    pMapping->pBuffer = pBuffer;
+
+    return true;
+}
+
+
+void blp_unmap(tBLPMapping* pMapping)
+{
+    if (pMapping->pBuffer)
+    {
+        blp_free(pMapping->pBuffer);
+    }
+    else
+    {
+        tFileMapping mapping = { static_cast<const uint8_t*>(pMapping->pData), pMapping->size };
+        blp_unmapFile(&mapping);
+    }
+
+    pMapping->pData   = 0;
+    pMapping->size    = 0;
+    pMapping->pBuffer = 0;
+}
+
+
+tBGRAPixel* blp_convertAllMips(FILE* pFile, tBLPInfos blpInfos, size_t* pOffsets)
+{
+    tBLPSource source = blp_openFileSource(pFile);
+    tBGRAPixel* pDst = blp_convertSourceAllMipsWith(&source, static_cast<tInternalBLPInfos*>(blpInfos), pOffsets);
+    blp_closeFileSource(&source);
+
+    return pDst;
+}
+
+
+tBGRAPixel* blp_convertMemoryAllMips(const void* pData, size_t size, tBLPInfos blpInfos, size_t* pOffsets)
+{
+    tBLPSource source = blp_memorySource(pData, size);
+
+    return blp_convertSourceAllMipsWith(&source, static_cast<tInternalBLPInfos*>(blpInfos), pOffsets);
+}
+
+
+tBGRAPixel* blp_convertSourceAllMips(const tBLPSource* pSource, tBLPInfos blpInfos, size_t* pOffsets)
+{
+    return blp_convertSourceAllMipsWith(pSource, static_cast<tInternalBLPInfos*>(blpInfos), pOffsets);
+}
+
+
+tBGRAPixel* blp_convertSourceAllMipsWith(const tBLPSource* pSource, tInternalBLPInfos* pBLPInfos, size_t* pOffsets)
+{
+    if (pSource->pData)
+        return blp_convertAllMipsFrom(pBLPInfos, static_cast<const uint8_t*>(pSource->pData), 0, pSource->dataSize, pOffsets);
+
+    // Read all the mip levels at once
+    unsigned int nbMipLevels = blp_nbMipLevels(pBLPInfos);
+    if (nbMipLevels == 0)
+        return 0;
+
+    uint32_t start = 0xFFFFFFFF;
+    uint32_t end = 0;
+
+    for (unsigned int i = 0; i < nbMipLevels; ++i)
+    {
+        uint32_t offset;
+        uint32_t length;
+        blp_mipRange(pBLPInfos, i, &offset, &length);
+
+        start = std::min(start, offset);
+        end   = std::max(end, uint32_t(std::min(uint64_t(offset) + length, uint64_t(0xFFFFFFFF))));
+    }
+
+    // Not past the end of the data (the ranges are checked afterwards)
+    end = uint32_t(std::min(size_t(end), std::max(pSource->size(pSource->pUserData), size_t(start))));
+    if (start >= end)
+        return 0;
+
+    uint8_t* pSrc = blp_acquireScratch(pBLPInfos->pContext, BLP_SCRATCH_SOURCE, end - start);
+    if (!pSrc)
+        return 0;
+
+    size_t size = pSource->readAt(pSource->pUserData, start, pSrc, end - start);
+
+    tBGRAPixel* pDst = blp_convertAllMipsFrom(pBLPInfos, pSrc, start, size, pOffsets);
+
+    blp_releaseScratch(pBLPInfos->pContext, pSrc);
+
+    return pDst;
+}
+
+
+// Converts all the mip levels in one buffer. 'pData' contains 'size' bytes of
+// the BLP file, starting at 'dataOffset'.
+tBGRAPixel* blp_convertAllMipsFrom(tInternalBLPInfos* pBLPInfos, const uint8_t* pData, uint32_t dataOffset, size_t size, size_t* pOffsets)
+{
+    unsigned int nbMipLevels = blp_nbMipLevels(pBLPInfos);
+    if (nbMipLevels == 0)
+        return 0;
+
+    size_t nbPixels = 0;
+
+    for (unsigned int i = 0; i < nbMipLevels; ++i)
+    {
+        uint32_t offset;
+        uint32_t length;
+        blp_mipRange(pBLPInfos, i, &offset, &length);
+
+        // Each mip level must start in the buffer (see below for its end)
+        if ((offset < dataOffset) || (offset - dataOffset > size))
+            return 0;
+
+        pOffsets[i] = nbPixels;
+        nbPixels += size_t(blp_width(pBLPInfos, i)) * blp_height(pBLPInfos, i);
+    }
+
+    tBGRAPixel* pDst = blp_allocateArray<tBGRAPixel>(nbPixels);
+    if (!pDst)
+        return 0;
+
+    for (unsigned int i = 0; i < nbMipLevels; ++i)
+    {
+        uint32_t offset;
+        uint32_t length;
+        blp_mipRange(pBLPInfos, i, &offset, &length);
+
+        // Not past the end of the data, like blp_convertSourceMip()
+        size_t start = offset - dataOffset;
+        length = uint32_t(std::min(size_t(length), size - start));
+
+        if (!blp_convertMip(pBLPInfos, pData + start, length, i, 1, 0, BLP_PIXEL_FORMAT_BGRA, pDst + pOffsets[i], 0, 0, 0))
+        {
+            blp_free(pDst);
+            return 0;
+        }
+    }
+
+    return pDst;
+}
+
+
+// State of a thread converting the files of a batch
+struct tBatchThread
+{
+    tInternalBLPContext* pContext;      // Created on the first file
+    size_t               nbConverted;
+};
+
+
+struct tBatchJob
+{
+    const tBLPBatchInput*   pInputs;
+    size_t                  firstInput; // Of the items of the current job
+    const tBLPBatchOptions* pOptions;
+    tBLPBatchCallback       callback;
+    void*                   pUserData;
+    tBatchThread*           pThreads;   // One per thread of the pool
+};
+
+
+// Reads, processes and converts one file of a batch (in the buffers of the
+// context of the thread), and gives the result to the callback
+static bool blp_convertBatchInput(tBatchJob* pJob, tBatchThread* pThread, size_t index)
+{
+    const tBLPBatchInput* pInput = &pJob->pInputs[index];
+    const tBLPBatchOptions* pOptions = pJob->pOptions;
+
+    if (!pThread->pContext)
+        pThread->pContext = static_cast<tInternalBLPContext*>(blp_createContext());
+
+    FILE* pFile = 0;
+    tBLPSource source = pInput->source;
+    bool bReadable = (pThread->pContext != 0);
+
+    if (pInput->pPath)
+    {
+        pFile = fopen(pInput->pPath, "rb");
+
+        if (pFile)
+            source = blp_openFileSource(pFile);
+        else
+            bReadable = false;
+    }
+
+    tBLPInfos blpInfos = (bReadable ? blp_processSourceWith(&source, pThread->pContext) : 0);
+    const uint8_t* pPixels = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    if (blpInfos)
+    {
+        blp_scaledSize(blpInfos, pOptions->mipLevel, pOptions->scaleDenom, &width, &height);
+
+        uint8_t* pDst = blp_reserve(&pThread->pContext->scratch[BLP_SCRATCH_OUTPUT],
+                                    size_t(width) * height * blp_pixelSize(pOptions->format));
+
+        if (pDst && blp_convertSourceMip(&source, static_cast<tInternalBLPInfos*>(blpInfos), pOptions->mipLevel, pOptions->scaleDenom,
+                                         0, pOptions->format, pDst, 0, 0, 0))
+        {
+            pPixels = pDst;
+        }
+    }
+
+    if (!pPixels)
+    {
+        width  = 0;
+        height = 0;
+    }
+
+    pJob->callback(pJob->pUserData, index, blpInfos, pPixels, width, height);
+
+    if (pFile)
+    {
+        blp_closeFileSource(&source);
+        fclose(pFile);
+    }
+
+    return (pPixels != 0);
+}
+
+
+static void blp_convertBatchInputs(void* pUserData, unsigned int thread, unsigned int first, unsigned int count)
+{
+    tBatchJob* pJob = static_cast<tBatchJob*>(pUserData);
+    tBatchThread* pThread = &pJob->pThreads[thread];
+
+    for (unsigned int i = first; i < first + count; ++i)
+    {
+        if (blp_convertBatchInput(pJob, pThread, pJob->firstInput + i))
+            ++pThread->nbConverted;
+    }
+}
+
+
+size_t blp_convertBatch(const tBLPBatchInput* pInputs, size_t nbInputs, const tBLPBatchOptions* pOptions,
+                        tBLPBatchCallback callback, void* pUserData)
+{
+    if (!pInputs || !pOptions || !callback || (nbInputs == 0))
+        return 0;
+
+    unsigned int nbThreads = blp_nbPoolThreads();
+
+    tBatchJob job;
+    job.pInputs    = pInputs;
+    job.firstInput = 0;
+    job.pOptions   = pOptions;
+    job.callback   = callback;
+    job.pUserData  = pUserData;
+    job.pThreads   = blp_allocateArray<tBatchThread>(nbThreads);
+
+    if (!job.pThreads)
+        return 0;
+
+    memset(job.pThreads, 0, nbThreads * sizeof(tBatchThread));
+
+    // The pool counts the items with unsigned integers
+    const size_t maxItems = 0x40000000;
+
+    for (; job.firstInput < nbInputs; job.firstInput += maxItems)
+        blp_parallelItems(blp_convertBatchInputs, &job, unsigned(std::min(nbInputs - job.firstInput, maxItems)));
+
+    size_t nbConverted = 0;
+
+    for (unsigned int i = 0; i < nbThreads; ++i)
+    {
+        nbConverted += job.pThreads[i].nbConverted;
+
+        if (job.pThreads[i].pContext)
+            blp_releaseContext(job.pThreads[i].pContext);
+    }
+
+    blp_free(job.pThreads);
+
+    return nbConverted;
+}
+
+
+unsigned int blp_checkMipLevel(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel)
+{
+    if (pBLPInfos->version == 2)
+    {
+        if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
+            mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
+    }
+    else
+    {
+        if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
+            mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
+    }
+
+    return mipLevel;
+}
+
+
+// Returns the mip level to decode for a reduced size, and the scaling to apply
+// while decoding it ('pDecoderScale' receives the denominator). The JPEG images
+// are scaled by libjpeg. The other formats use the smaller mip levels, as far as
+// they exist. Past the last one, DXT images can still be reduced by 4 (one pixel
+// per block).
+unsigned int blp_scaledMipLevel(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom, unsigned int* pDecoderScale)
+{
+    mipLevel = blp_checkMipLevel(pBLPInfos, mipLevel);
+
+    // Only 1, 2, 4 and 8 are supported (libjpeg 7 can do more, but not without
+    // a cost in quality)
+    unsigned int shift = 0;
+    while ((shift < 3) && (scaleDenom >= (2u << shift)))
+        ++shift;
+
+    tBLPFormat format = blp_format(pBLPInfos);
+
+    if (format == BLP_FORMAT_JPEG)
+    {
+        *pDecoderScale = 1 << shift;
+        return mipLevel;
+    }
+
+    *pDecoderScale = 1;
+
+    unsigned int scaledMipLevel = blp_checkMipLevel(pBLPInfos, mipLevel + shift);
+
+    if (((format >> 16) == BLP_ENCODING_DXT) && (shift - (scaledMipLevel - mipLevel) >= 2))
+    {
+        *pDecoderScale = 4;
+        scaledMipLevel = blp_checkMipLevel(pBLPInfos, mipLevel + shift - 2);
+    }
+
+    return scaledMipLevel;
+}
+
+
+void blp_mipRange(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, uint32_t* pOffset, uint32_t* pLength)
+{
+    if (pBLPInfos->version == 2)
+    {
+        *pOffset = pBLPInfos->blp2.offsets[mipLevel];
+        *pLength = pBLPInfos->blp2.lengths[mipLevel];
+    }
+    else
+    {
+        *pOffset = pBLPInfos->blp1.header.offsets[mipLevel];
+        *pLength = pBLPInfos->blp1.header.lengths[mipLevel];
+    }
+}
+
+
+// Converts a mip level at a reduced size (or the rectangle 'pRegion' of it, when
+// not 0), either in 'pDst' or by bands given to 'callback' (when not 0)
+bool blp_convertFileMip(FILE* pFile, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom, const tRegion* pRegion,
+                        tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData)
+{
+    tBLPSource source = blp_openFileSource(pFile);
+    bool bResult = blp_convertSourceMip(&source, pBLPInfos, mipLevel, scaleDenom, pRegion, format, pDst, dstStride, callback, pUserData);
+    blp_closeFileSource(&source);
+
+    return bResult;
+}
+
+
+bool blp_convertMemoryMip(const void* pData, size_t size, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                          const tRegion* pRegion, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData)
+{
+    tBLPSource source = blp_memorySource(pData, size);
+
+    return blp_convertSourceMip(&source, pBLPInfos, mipLevel, scaleDenom, pRegion, format, pDst, dstStride, callback, pUserData);
+}
+
+
+// The mip level is decoded in place when the source is in memory, or else read
+// in a temporary buffer
+bool blp_convertSourceMip(const tBLPSource* pSource, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                          const tRegion* pRegion, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData)
+{
+    unsigned int decoderScale;
+    mipLevel = blp_scaledMipLevel(pBLPInfos, mipLevel, scaleDenom, &decoderScale);
 
+    uint32_t offset;
+    uint32_t length;
+    blp_mipRange(pBLPInfos, mipLevel, &offset, &length);
 
-tBLPInfos blp_processFile(FILE* pFile)
+    // Not past the end of the data, whatever the source (blp_convertMip()
+    // rejects the mip levels too short for their image)
+    size_t size = (pSource->pData ? pSource->dataSize : pSource->size(pSource->pUserData));
+    size_t start = std::min(size, size_t(offset));
+    length = uint32_t(std::min(size_t(length), size - start));
+
+    if (pSource->pData)
+    {
+        return blp_convertMip(pBLPInfos, static_cast<const uint8_t*>(pSource->pData) + start, length, mipLevel, decoderScale, pRegion,
+                              format, pDst, dstStride, callback, pUserData);
+    }
+
+    uint8_t* pSrc = blp_acquireScratch(pBLPInfos->pContext, BLP_SCRATCH_SOURCE, length);
+    if (!pSrc)
+        return false;
+
+    length = uint32_t(pSource->readAt(pSource->pUserData, offset, pSrc, length));
+
+    bool bResult = blp_convertMip(pBLPInfos, pSrc, length, mipLevel, decoderScale, pRegion, format, pDst, dstStride, callback, pUserData);
+
+    blp_releaseScratch(pBLPInfos->pContext, pSrc);
+
+    return bResult;
+}
+
+
+// 'scale' is the denominator of the scaling done during the decoding: 1, 2, 4
+// or 8 for JPEG images, 1 or 4 (one pixel per block) for DXT images. 'pRegion'
+// is in the reduced size (0: the whole image). When streaming, 'pDst' is ignored
+// and a buffer holding one band is used instead.
+bool blp_convertMip(tInternalBLPInfos* pBLPInfos, const uint8_t* pSrc, uint32_t size, unsigned int mipLevel, unsigned int scale,
+                    const tRegion* pRegion, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride, tBLPRowsCallback callback, void* pUserData)
 {
-    tInternalBLPInfos* pBLPInfos = new tInternalBLPInfos();
-    char magic[4];
+    // Declarations
+    unsigned int width  = (blp_width(pBLPInfos, mipLevel) + scale - 1) / scale;
+    unsigned int height = (blp_height(pBLPInfos, mipLevel) + scale - 1) / scale;
 
-    fseek(pFile, 0, SEEK_SET);
-    fread((void*) magic, sizeof(uint8_t), 4, pFile);
+    tBLPFormat blpFormat = blp_format(pBLPInfos);
 
-    if (strncmp(magic, "BLP2", 4) == 0)
-    {
-        pBLPInfos->version = 2;
+    if (blp_pixelSize(format) == 0)
+        return false;
 
-        fseek(pFile, 0, SEEK_SET);
-        fread((void*) &pBLPInfos->blp2, sizeof(tBLP2Header), 1, pFile);
+    tRegion region = { 0, 0, width, height };
+    if (pRegion)
+    {
+        // The region must be entirely contained in the image
+        if ((pRegion->width == 0) || (pRegion->height == 0) ||
+            (pRegion->x > width) || (pRegion->width > width - pRegion->x) ||
+            (pRegion->y > height) || (pRegion->height > height - pRegion->y))
+            return false;
 
-        pBLPInfos->blp2.nbMipLevels = 0;
-        while ((pBLPInfos->blp2.offsets[pBLPInfos->blp2.nbMipLevels] != 0) && (pBLPInfos->blp2.nbMipLevels < 16))
-            ++pBLPInfos->blp2.nbMipLevels;
+        region = *pRegion;
     }
-    else if (strncmp(magic, "BLP1", 4) == 0)
+
+    // Don't let the converters read past the end of the data
+    if (size < blp_minimumMipSize(pBLPInfos, mipLevel))
+        return false;
+
+    const tBGRAPixel* pPalette = (pBLPInfos->version == 2 ? pBLPInfos->blp2.palette : pBLPInfos->blp1.infos.palette);
+
+    // Premultiplying opaque pixels changes nothing
+    if ((blpFormat == BLP_FORMAT_JPEG) || (blpFormat == BLP_FORMAT_PALETTED_NO_ALPHA))
     {
-        pBLPInfos->version = 1;
+        if (format == BLP_PIXEL_FORMAT_BGRA_PREMULTIPLIED)
+            format = BLP_PIXEL_FORMAT_BGRA;
+        else if (format == BLP_PIXEL_FORMAT_RGBA_PREMULTIPLIED)
+            format = BLP_PIXEL_FORMAT_RGBA;
+    }
 
-        fseek(pFile, 0, SEEK_SET);
-        fread((void*) &pBLPInfos->blp1.header, sizeof(tBLP1Header), 1, pFile);
+    tRowSink sink;
+    sink.pBuffer    = static_cast<uint8_t*>(pDst);
+    sink.stride     = (dstStride != 0 ? dstStride : ptrdiff_t(region.width) * blp_pixelSize(format));
+    sink.convert    = blp_pixelRowFunction(format);
+    sink.callback   = callback;
+    sink.pUserData  = pUserData;
+    sink.bandHeight = 1;
+    sink.height     = region.height;
+    sink.pContext   = pBLPInfos->pContext;
+
+    // When streaming, the DXT images are delivered one row of blocks at a time
+    if (callback)
+    {
+        if (((blpFormat >> 16) == BLP_ENCODING_DXT) && (scale != 4))
+            sink.bandHeight = 4;
 
-        pBLPInfos->blp1.infos.nbMipLevels = 0;
-        while ((pBLPInfos->blp1.header.offsets[pBLPInfos->blp1.infos.nbMipLevels] != 0) && (pBLPInfos->blp1.infos.nbMipLevels < 16))
-            ++pBLPInfos->blp1.infos.nbMipLevels;
+        sink.stride  = ptrdiff_t(region.width) * blp_pixelSize(format);
+        sink.pBuffer = blp_acquireScratch(sink.pContext, BLP_SCRATCH_BAND, sink.stride * sink.bandHeight);
+        if (!sink.pBuffer)
+            return false;
+    }
 
-        if (pBLPInfos->blp1.header.type == 0)
-        {
-            fread((void*) &pBLPInfos->blp1.infos.jpeg.headerSize, sizeof(uint32_t), 1, pFile);
+    // Paletted images are directly decoded in RGBA, with the red and blue
+    // components of the palette swapped
+    tBGRAPixel swappedPalette[256];
 
-            if (pBLPInfos->blp1.infos.jpeg.headerSize > 0)
-            {
-                pBLPInfos->blp1.infos.jpeg.header = new uint8_t[pBLPInfos->blp1.infos.jpeg.headerSize];
-                fread((void*) pBLPInfos->blp1.infos.jpeg.header, sizeof(uint8_t), pBLPInfos->blp1.infos.jpeg.headerSize, pFile);
-            }
-            else
-            {
-                pBLPInfos->blp1.infos.jpeg.header = 0;
-            }
-        }
-        else
+    if ((format == BLP_PIXEL_FORMAT_RGBA) && ((blpFormat >> 16) == BLP_ENCODING_UNCOMPRESSED))
+    {
+        for (unsigned int i = 0; i < 256; ++i)
         {
-            fread((void*) &pBLPInfos->blp1.infos.palette, sizeof(pBLPInfos->blp1.infos.palette), 1, pFile);
+            swappedPalette[i]   = pPalette[i];
+            swappedPalette[i].b = pPalette[i].r;
+            swappedPalette[i].r = pPalette[i].b;
         }
-    }
-    else
-    {
-        delete pBLPInfos;
-        return 0;
+
+        pPalette     = swappedPalette;
+        sink.convert = 0;
     }
 
-    return (tBLPInfos) pBLPInfos;
+    bool bResult = (pBLPInfos->decoder != 0) &&
+                   pBLPInfos->decoder(pBLPInfos, pSrc, size, scale, pPalette, width, height, &region, &sink);
+
+    if (callback)
+        blp_releaseScratch(sink.pContext, sink.pBuffer);
+
+    return bResult;
 }
 
 
-void blp_release(tBLPInfos blpInfos)
+// Computed on 64 bits: the dimensions come from the file, and the product of
+// two 32-bit values would wrap
+uint64_t blp_minimumMipSize(tInternalBLPInfos* pBLPInfos, unsigned int mipLevel)
 {
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+    uint64_t width  = blp_width(pBLPInfos, mipLevel);
+    uint64_t height = blp_height(pBLPInfos, mipLevel);
+    uint64_t nbPixels = width * height;
 
-    if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.type == 0))
-        delete[] pBLPInfos->blp1.infos.jpeg.header;
+    switch (blp_format(pBLPInfos))
+    {
+        case BLP_FORMAT_PALETTED_NO_ALPHA: return nbPixels;
+        case BLP_FORMAT_PALETTED_ALPHA_1:  return nbPixels + (nbPixels + 7) / 8;
+        case BLP_FORMAT_PALETTED_ALPHA_4:  return nbPixels + (nbPixels + 1) / 2;
 
-    delete pBLPInfos;
-}
+        case BLP_FORMAT_PALETTED_ALPHA_8:
+            if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.alphaEncoding == 5))
+                return nbPixels;
+            return nbPixels * 2;
 
+        case BLP_FORMAT_RAW_BGRA:          return nbPixels * 4;
 
-uint8_t blp_version(tBLPInfos blpInfos)
-{
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+        case BLP_FORMAT_DXT1_NO_ALPHA:
+        case BLP_FORMAT_DXT1_ALPHA_1:      return ((width + 3) / 4) * ((height + 3) / 4) * 8;
 
-    return pBLPInfos->version;
+        case BLP_FORMAT_DXT3_ALPHA_4:
+        case BLP_FORMAT_DXT3_ALPHA_8:
+        case BLP_FORMAT_DXT5_ALPHA_8:      return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+
+        default:                           return 0;
+    }
 }
 
 
-tBLPFormat blp_format(tBLPInfos blpInfos)
+static size_t blp_fileSourceReadAt(void* pUserData, size_t offset, void* pDst, size_t size)
 {
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+    return blp_readAt(static_cast<FILE*>(pUserData), offset, pDst, size);
+}
 
-    if (pBLPInfos->version == 2)
-    {
-        if (pBLPInfos->blp2.type == 0)
-            return BLP_FORMAT_JPEG;
 
-        if (pBLPInfos->blp2.encoding == BLP_ENCODING_UNCOMPRESSED)
-            return tBLPFormat((pBLPInfos->blp2.encoding << 16) | (pBLPInfos->blp2.alphaDepth << 8));
+static size_t blp_fileSourceSize(void* pUserData)
+{
+    return blp_fileSize(static_cast<FILE*>(pUserData));
+}
 
-        if (pBLPInfos->blp2.encoding == BLP_ENCODING_UNCOMPRESSED_RAW_BGRA)
-            return tBLPFormat((pBLPInfos->blp2.encoding << 16));
 
-        return tBLPFormat((pBLPInfos->blp2.encoding << 16) | (pBLPInfos->blp2.alphaDepth << 8) | pBLPInfos->blp2.alphaEncoding);
-    }
-    else
-    {
-        if (pBLPInfos->blp1.header.type == 0)
-            return BLP_FORMAT_JPEG;
+// A source reading a file with positional reads
+tBLPSource blp_fileSource(FILE* pFile)
+{
+    tBLPSource source = { blp_fileSourceReadAt, blp_fileSourceSize, pFile, 0, 0 };
+    return source;
+}
 
-        if ((pBLPInfos->blp1.header.flags & 0x8) != 0)
-            return BLP_FORMAT_PALETTED_ALPHA_8;
 
-        return BLP_FORMAT_PALETTED_NO_ALPHA;
-    }
+tBLPSource blp_memorySource(const void* pData, size_t size)
+{
+    tBLPSource source = { 0, 0, 0, pData, size };
+    return source;
 }
 
 
-unsigned int blp_width(tBLPInfos blpInfos, unsigned int mipLevel)
+// Same as blp_fileSource(), but the whole file is mapped in memory when possible.
+// To release with blp_closeFileSource().
+tBLPSource blp_openFileSource(FILE* pFile)
 {
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+    tFileMapping mapping;
 
-    if (pBLPInfos->version == 2)
-    {
-        // Check the mip level
-        if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
-            mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
+    if (blp_mapFile(pFile, &mapping))
+        return blp_memorySource(mapping.pData, mapping.size);
 
-        return (pBLPInfos->blp2.width >> mipLevel);
-    }
-    else
-    {
-        // Check the mip level
-        if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
-            mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
+    return blp_fileSource(pFile);
+}
 
-        return (pBLPInfos->blp1.header.width >> mipLevel);
+
+void blp_closeFileSource(tBLPSource* pSource)
+{
+    if (pSource->pData)
+    {
+        tFileMapping mapping = { static_cast<const uint8_t*>(pSource->pData), pSource->dataSize };
+        blp_unmapFile(&mapping);
     }
 }
 
 
-unsigned int blp_height(tBLPInfos blpInfos, unsigned int mipLevel)
+bool blp_mapFile(FILE* pFile, tFileMapping* pMapping)
 {
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+#ifndef _WIN32
+    struct stat infos;
 
-    if (pBLPInfos->version == 2)
-    {
-        // Check the mip level
-        if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
-            mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
+    int fd = fileno(pFile);
+    if ((fd < 0) || (fstat(fd, &infos) != 0) || !S_ISREG(infos.st_mode) || (infos.st_size <= 0))
+        return false;
 
-        return (pBLPInfos->blp2.height >> mipLevel);
-    }
-    else
-    {
-        // Check the mip level
-        if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
-            mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
+    void* pData = mmap(0, infos.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pData == MAP_FAILED)
+        return false;
 
-        return (pBLPInfos->blp1.header.height >> mipLevel);
-    }
+    pMapping->pData = static_cast<const uint8_t*>(pData);
+    pMapping->size  = infos.st_size;
+
+    return true;
+#else
+    return false;
+#endif
 }
 
 
-unsigned int blp_nbMipLevels(tBLPInfos blpInfos)
+void blp_unmapFile(tFileMapping* pMapping)
 {
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
-
-    if (pBLPInfos->version == 2)
-        return pBLPInfos->blp2.nbMipLevels;
-    else
-        return pBLPInfos->blp1.infos.nbMipLevels;
+#ifndef _WIN32
+    munmap((void*) pMapping->pData, pMapping->size);
+#endif
 }
 
 
-tBGRAPixel* blp_convert(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel)
+size_t blp_fileSize(FILE* pFile)
 {
-    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+#ifndef _WIN32
+    struct stat infos;
 
-    // Check the mip level
-    if (pBLPInfos->version == 2)
-    {
-        if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
-            mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
-    }
-    else
-    {
-        if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
-            mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
-    }
+    int fd = fileno(pFile);
+    if (fd >= 0)
+        return ((fstat(fd, &infos) == 0) && (infos.st_size > 0) ? infos.st_size : 0);
+#endif
 
-    // Declarations
-    unsigned int width  = blp_width(pBLPInfos, mipLevel);
-    unsigned int height = blp_height(pBLPInfos, mipLevel);
-    tBGRAPixel* pDst    = 0;
-    uint8_t* pSrc       = 0;
-    uint32_t offset;
-    uint32_t size;
+    // Without descriptor: measured with the position of the file, which is then
+    // restored (see blp_readAt() for the lock)
+#ifndef _WIN32
+    flockfile(pFile);
+#endif
 
-    if (pBLPInfos->version == 2)
-    {
-        offset = pBLPInfos->blp2.offsets[mipLevel];
-        size   = pBLPInfos->blp2.lengths[mipLevel];
-    }
-    else
+    long size = 0;
+    long position = ftell(pFile);
+
+    if ((position >= 0) && (fseek(pFile, 0, SEEK_END) == 0))
     {
-        offset = pBLPInfos->blp1.header.offsets[mipLevel];
-        size   = pBLPInfos->blp1.header.lengths[mipLevel];
+        size = ftell(pFile);
+        fseek(pFile, position, SEEK_SET);
     }
 
-    pSrc = new uint8_t[size];
+#ifndef _WIN32
+    funlockfile(pFile);
+#endif
 
-    // Read the data from the file
-    fseek(pFile, offset, SEEK_SET);
-    fread((void*) pSrc, sizeof(uint8_t), size, pFile);
+    return (size > 0 ? size : 0);
+}
 
-    switch (blp_format(pBLPInfos))
+
+// Positional read: the position of the file isn't used (nor modified) when the
+// file has a descriptor, so several threads can read from the same FILE*. The
+// other files (fmemopen(), fopencookie(), ...) are read with fseek() and fread(),
+// under the lock of the FILE* on POSIX systems. On Windows, the caller must
+// serialise the calls sharing a FILE*. Returns 0 if the offset can't be reached.
+size_t blp_readAt(FILE* pFile, size_t offset, void* pDst, size_t size)
+{
+#ifndef _WIN32
+    int fd = fileno(pFile);
+    if (fd >= 0)
     {
-        case BLP_FORMAT_JPEG:
-            // if (pBLPInfos->version == 2)
-            //     pDst = blp2_convert_paletted_no_alpha(pSrc, &pBLPInfos->blp2, width, height);
-            // else
-                pDst = blp1_convert_jpeg(pSrc, &pBLPInfos->blp1.infos, size);
-            break;
+        size_t total = 0;
 
-        case BLP_FORMAT_PALETTED_NO_ALPHA:
-            if (pBLPInfos->version == 2)
-                pDst = blp2_convert_paletted_no_alpha(pSrc, &pBLPInfos->blp2, width, height);
+        while (total < size)
+        {
+            ssize_t nbRead = pread(fd, static_cast<uint8_t*>(pDst) + total, size - total, off_t(offset) + total);
+            if (nbRead > 0)
+                total += nbRead;
+            else if ((nbRead < 0) && (errno == EINTR))
+                continue;
             else
-                pDst = blp1_convert_paletted_no_alpha(pSrc, &pBLPInfos->blp1.infos, width, height);
-            break;
-
-        case BLP_FORMAT_PALETTED_ALPHA_1:  pDst = blp2_convert_paletted_alpha1(pSrc, &pBLPInfos->blp2, width, height); break;
-
-        case BLP_FORMAT_PALETTED_ALPHA_4:  pDst = blp2_convert_paletted_alpha4(pSrc, &pBLPInfos->blp2, width, height); break;
+                break;
+        }
 
-        case BLP_FORMAT_PALETTED_ALPHA_8:
-            if (pBLPInfos->version == 2)
-            {
-                pDst = blp2_convert_paletted_alpha8(pSrc, &pBLPInfos->blp2, width, height);
-            }
-            else
-            {
-                if (pBLPInfos->blp1.header.alphaEncoding == 5)
-                    pDst = blp1_convert_paletted_alpha(pSrc, &pBLPInfos->blp1.infos, width, height);
-                else
-                    pDst = blp1_convert_paletted_separated_alpha(pSrc, &pBLPInfos->blp1.infos, width, height);
-            }
-            break;
+        return total;
+    }
+#endif
 
-        case BLP_FORMAT_RAW_BGRA: pDst = blp2_convert_raw_bgra(pSrc, &pBLPInfos->blp2, width, height); break;
+#ifndef _WIN32
+    flockfile(pFile);
+#endif
 
-        case BLP_FORMAT_DXT1_NO_ALPHA:
-        case BLP_FORMAT_DXT1_ALPHA_1:      pDst = blp2_convert_dxt(pSrc, &pBLPInfos->blp2, width, height, squish::kDxt1); break;
-        case BLP_FORMAT_DXT3_ALPHA_4:
-        case BLP_FORMAT_DXT3_ALPHA_8:      pDst = blp2_convert_dxt(pSrc, &pBLPInfos->blp2, width, height, squish::kDxt3); break;
-        case BLP_FORMAT_DXT5_ALPHA_8:      pDst = blp2_convert_dxt(pSrc, &pBLPInfos->blp2, width, height, squish::kDxt5); break;
-        default:                           break;
-    }
+    size_t nbRead = 0;
+    if ((offset <= size_t(LONG_MAX)) && (fseek(pFile, long(offset), SEEK_SET) == 0))
+        nbRead = fread(pDst, sizeof(uint8_t), size, pFile);
 
-    delete[] pSrc;
+#ifndef _WIN32
+    funlockfile(pFile);
+#endif
 
-    return pDst;
+    return nbRead;
 }
 
 
@@ -295,279 +1554,311 @@ std::string blp_asString(tBLPFormat format)
 }
 
 
-tBGRAPixel* blp1_convert_jpeg(uint8_t* pSrc, tBLP1Infos* pInfos, uint32_t size)
+unsigned int blp_pixelSize(tBLPPixelFormat format)
 {
-    uint8_t* pSrcBuffer = new uint8_t[pInfos->jpeg.headerSize + size];
-
-    memcpy(pSrcBuffer, pInfos->jpeg.header, pInfos->jpeg.headerSize);
-    memcpy(pSrcBuffer + pInfos->jpeg.headerSize, pSrc, size);
+    switch (format)
+    {
+        case BLP_PIXEL_FORMAT_BGRA:
+        case BLP_PIXEL_FORMAT_RGBA:
+        case BLP_PIXEL_FORMAT_BGRA_PREMULTIPLIED:
+        case BLP_PIXEL_FORMAT_RGBA_PREMULTIPLIED: return 4;
+        case BLP_PIXEL_FORMAT_RGB:                return 3;
+        case BLP_PIXEL_FORMAT_ALPHA:              return 1;
+        default:                                  return 0;
+    }
+}
 
-    FIMEMORY* pMemory = FreeImage_OpenMemory(pSrcBuffer, pInfos->jpeg.headerSize + size);
 
-    FIBITMAP* pBitmap = FreeImage_LoadFromMemory(FIF_JPEG, pMemory);
+// Returns the function converting the decoded BGRA rows into the given format
+// (0 for BGRA: the rows are decoded directly in the destination buffer)
+tPixelRowFunction blp_pixelRowFunction(tBLPPixelFormat format)
+{
+    const tPixelFormatKernels* pKernels = blp_pixelFormatKernels();
 
-    unsigned int width = FreeImage_GetWidth(pBitmap);
-    unsigned int height = FreeImage_GetHeight(pBitmap);
-    unsigned int bytespp = FreeImage_GetLine(pBitmap) / FreeImage_GetWidth(pBitmap);
+    switch (format)
+    {
+        case BLP_PIXEL_FORMAT_RGBA:               return pKernels->rgba;
+        case BLP_PIXEL_FORMAT_RGB:                return pKernels->rgb;
+        case BLP_PIXEL_FORMAT_BGRA_PREMULTIPLIED: return pKernels->bgraPremultiplied;
+        case BLP_PIXEL_FORMAT_RGBA_PREMULTIPLIED: return pKernels->rgbaPremultiplied;
+        case BLP_PIXEL_FORMAT_ALPHA:              return pKernels->alpha;
+        default:                                  return 0;
+    }
+}
 
 
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+// The decoders only forward to the functions below, with the kernels matching
+// the format of the image (resolved when called, see blp_getActiveKernels())
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        BYTE* pSrc2 = FreeImage_GetScanLine(pBitmap, height - y - 1);
+static bool blp_decode_jpeg(tInternalBLPInfos* pBLPInfos, const uint8_t* pSrc, uint32_t size, unsigned int scale,
+                            const tBGRAPixel* /*pPalette*/, unsigned int width, unsigned int height,
+                            const tRegion* pRegion, const tRowSink* pSink)
+{
+    return blp1_convert_jpeg(pSrc, &pBLPInfos->blp1.infos, size, scale, width, height, pRegion, pSink);
+}
 
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            // R and B are inverted in the JPEG file
-            pDst->r = pSrc2[FI_RGBA_BLUE];
-            pDst->g = pSrc2[FI_RGBA_GREEN];
-            pDst->b = pSrc2[FI_RGBA_RED];
-            pDst->a = 0xFF;
-
-            ++pDst;
-            pSrc2 += bytespp;
-        }
-    }
 
-    FreeImage_Unload(pBitmap);
+template <tPaletteRowFunction tPaletteKernels::*ROW_FUNCTION>
+static bool blp_decode_paletted(tInternalBLPInfos* /*pBLPInfos*/, const uint8_t* pSrc, uint32_t /*size*/, unsigned int /*scale*/,
+                                const tBGRAPixel* pPalette, unsigned int width, unsigned int height,
+                                const tRegion* pRegion, const tRowSink* pSink)
+{
+    return blp_convert_paletted(pSrc, pPalette, blp_paletteKernels()->*ROW_FUNCTION, width, height, pRegion, pSink);
+}
 
-    FreeImage_CloseMemory(pMemory);
 
-    return pBuffer;
+static bool blp_decode_raw_bgra(tInternalBLPInfos* pBLPInfos, const uint8_t* pSrc, uint32_t /*size*/, unsigned int /*scale*/,
+                                const tBGRAPixel* /*pPalette*/, unsigned int width, unsigned int height,
+                                const tRegion* pRegion, const tRowSink* pSink)
+{
+    return blp2_convert_raw_bgra(pSrc, &pBLPInfos->blp2, width, height, pRegion, pSink);
 }
 
 
-tBGRAPixel* blp1_convert_paletted_separated_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height)
+// A scale of 4 uses the average colour of each block
+template <tDXTRowFunction tDXTKernels::*ROW_FUNCTION, tDXTAverageFunction tDXTKernels::*AVERAGE_FUNCTION, unsigned int BLOCK_SIZE>
+static bool blp_decode_dxt(tInternalBLPInfos* /*pBLPInfos*/, const uint8_t* pSrc, uint32_t /*size*/, unsigned int scale,
+                           const tBGRAPixel* /*pPalette*/, unsigned int width, unsigned int height,
+                           const tRegion* pRegion, const tRowSink* pSink)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    const tDXTKernels* pKernels = blp_dxtKernels();
 
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
+    if (scale == 4)
+        return blp2_convert_dxt_averages(pSrc, pKernels->*AVERAGE_FUNCTION, BLOCK_SIZE, width, height, pRegion, pSink);
 
-    for (unsigned int y = 0; y < height; ++y)
+    return blp2_convert_dxt(pSrc, pKernels->*ROW_FUNCTION, BLOCK_SIZE, width, height, pRegion, pSink);
+}
+
+
+// Returns the decoder matching the format of the image, once and for all
+tMipDecoder blp_mipDecoder(tInternalBLPInfos* pBLPInfos)
+{
+    switch (blp_format(pBLPInfos))
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pInfos->palette[*pIndices];
-            pDst->a = *pAlpha;
+        case BLP_FORMAT_JPEG:
+            // Only BLP1 files have JPEG tables (in BLP2 files, the union holds the palette)
+            if (pBLPInfos->version == 2)
+                return 0;
+            return blp_decode_jpeg;
 
-            ++pIndices;
-            ++pAlpha;
-            ++pDst;
-        }
-    }
+        case BLP_FORMAT_PALETTED_NO_ALPHA: return blp_decode_paletted<&tPaletteKernels::noAlpha>;
+        case BLP_FORMAT_PALETTED_ALPHA_1:  return blp_decode_paletted<&tPaletteKernels::alpha1>;
+        case BLP_FORMAT_PALETTED_ALPHA_4:  return blp_decode_paletted<&tPaletteKernels::alpha4>;
 
-    return pBuffer;
-}
+        case BLP_FORMAT_PALETTED_ALPHA_8:
+            // BLP1 images may store the alpha channel in the palette
+            if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.alphaEncoding == 5))
+                return blp_decode_paletted<&tPaletteKernels::paletteAlpha>;
+            return blp_decode_paletted<&tPaletteKernels::alpha8>;
 
+        case BLP_FORMAT_RAW_BGRA:          return blp_decode_raw_bgra;
 
-tBGRAPixel* blp1_convert_paletted_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height)
-{
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+        case BLP_FORMAT_DXT1_NO_ALPHA:
+        case BLP_FORMAT_DXT1_ALPHA_1:      return blp_decode_dxt<&tDXTKernels::dxt1, &tDXTKernels::dxt1Average, 8>;
 
-    uint8_t* pIndices = pSrc;
+        case BLP_FORMAT_DXT3_ALPHA_4:
+        case BLP_FORMAT_DXT3_ALPHA_8:      return blp_decode_dxt<&tDXTKernels::dxt3, &tDXTKernels::dxt3Average, 16>;
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pInfos->palette[*pIndices];
-            pDst->a = 0xFF - pDst->a;
+        case BLP_FORMAT_DXT5_ALPHA_8:      return blp_decode_dxt<&tDXTKernels::dxt5, &tDXTKernels::dxt5Average, 16>;
 
-            ++pIndices;
-            ++pDst;
-        }
+        default:                           return 0;
     }
+}
+
 
-    return pBuffer;
+// Returns a scratch buffer of 'nbPixels' pixels (see blp_acquireScratch())
+static tBGRAPixel* blp_scratchRows(tInternalBLPContext* pContext, size_t nbPixels)
+{
+    return reinterpret_cast<tBGRAPixel*>(blp_acquireScratch(pContext, BLP_SCRATCH_ROWS, nbPixels * sizeof(tBGRAPixel)));
 }
 
 
-tBGRAPixel* blp1_convert_paletted_no_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height)
+// The indices are followed by the alpha plane (if any). The rows of indices are
+// contiguous, so only the part of the rows covered by the region is decoded.
+bool blp_convert_paletted(const uint8_t* pSrc, const tBGRAPixel* pPalette, tPaletteRowFunction rowFunction, unsigned int width, unsigned int height, const tRegion* pRegion, const tRowSink* pSink)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    const uint8_t* pAlpha = pSrc + size_t(width) * height;
+
+    tBGRAPixel* pScratch = (pSink->convert ? blp_scratchRows(pSink->pContext, pRegion->width) : 0);
+    if (pSink->convert && !pScratch)
+        return false;
 
-    uint8_t* pIndices = pSrc;
+    bool bResult = true;
 
-    for (unsigned int y = 0; y < height; ++y)
+    for (unsigned int y = 0; bResult && (y < pRegion->height); ++y)
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pInfos->palette[*pIndices];
-            pDst->a = 0xFF;
+        size_t start = size_t(pRegion->y + y) * width + pRegion->x;
 
-            ++pIndices;
-            ++pDst;
-        }
+        tBGRAPixel* pRow = blp_sinkRow(pSink, y, pScratch);
+        rowFunction(pPalette, pSrc + start, pAlpha, start, pRow, pRegion->width);
+        bResult = blp_flushRow(pSink, y, pRow, pRegion->width);
     }
 
-    return pBuffer;
+    blp_releaseScratch(pSink->pContext, pScratch);
+
+    return bResult;
 }
 
 
-tBGRAPixel* blp2_convert_paletted_no_alpha(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
+// The pixels are stored in the same order than tBGRAPixel, so they are either
+// copied or directly converted to the destination format
+bool blp2_convert_raw_bgra(const uint8_t* pSrc, tBLP2Header* /*pHeader*/, unsigned int width, unsigned int /*height*/, const tRegion* pRegion, const tRowSink* pSink)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    const tBGRAPixel* pPixels = reinterpret_cast<const tBGRAPixel*>(pSrc);
 
-    for (unsigned int y = 0; y < height; ++y)
+    for (unsigned int y = 0; y < pRegion->height; ++y)
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pSrc];
-            pDst->a = 0xFF;
+        const tBGRAPixel* pRow = pPixels + size_t(pRegion->y + y) * width + pRegion->x;
 
-            ++pSrc;
-            ++pDst;
-        }
+        if (!blp_copyRow(pSink, y, pRow, pRegion->width))
+            return false;
     }
 
-    return pBuffer;
+    return true;
 }
 
 
-tBGRAPixel* blp2_convert_paletted_alpha8(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
+// Parameters of the decoding of a DXT mip level, shared by all the threads
+struct tDXTJob
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
-
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
+    const uint8_t*  pSrc;       // First block of the region
+    tDXTRowFunction rowFunction;
+    unsigned int    rowSize;    // Size of a row of blocks, in bytes
+    tRegion         region;
+    const tRowSink* pSink;
+    bool*           pAborted;   // One flag per thread, set when the callback stops the streaming, or when out of memory
+};
+
+
+// Decodes the rows of blocks [first, first + count) of the region of a DXT mip
+// level (only the blocks it covers). The blocks are decoded directly in the
+// destination rows when possible. Otherwise (destination not in BGRA, or region
+// not aligned on the blocks), each row of blocks is decoded in a scratch buffer
+// of 4 rows of pixels, then copied or converted.
+static void blp2_convert_dxt_rows(void* pUserData, unsigned int thread, unsigned int first, unsigned int count)
+{
+    tDXTJob* pJob = static_cast<tDXTJob*>(pUserData);
+    const tRowSink* pSink = pJob->pSink;
+    const tRegion* pRegion = &pJob->region;
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pIndices];
-            pDst->a = *pAlpha;
+    const uint8_t* pSrc = pJob->pSrc + size_t(first) * pJob->rowSize;
 
-            ++pIndices;
-            ++pAlpha;
-            ++pDst;
-        }
-    }
+    // The region may start in the middle of the first column of blocks
+    unsigned int offsetX = pRegion->x % 4;
+    unsigned int width   = offsetX + pRegion->width;
+    unsigned int bottom  = pRegion->y + pRegion->height;
 
-    return pBuffer;
-}
+    bool bDirect = !pSink->convert && (offsetX == 0) && (pRegion->y % 4 == 0);
 
+    // When several threads share the decoding, the scratch buffer of the context
+    // (if any) is only used by the calling thread
+    tInternalBLPContext* pContext = (thread == 0 ? pSink->pContext : 0);
 
-tBGRAPixel* blp2_convert_paletted_alpha1(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
-{
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    tBGRAPixel* pScratch = (bDirect ? 0 : blp_scratchRows(pContext, size_t(width) * 4));
+    if (!bDirect && !pScratch)
+    {
+        pJob->pAborted[thread] = true;
+        return;
+    }
+    ptrdiff_t stride = ptrdiff_t(width) * sizeof(tBGRAPixel);
 
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
-    uint8_t counter = 0;
+    bool bContinue = true;
 
-    for (unsigned int y = 0; y < height; ++y)
+    for (unsigned int i = first; bContinue && (i < first + count); ++i)
     {
-        for (unsigned int x = 0; x < width; ++x)
+        unsigned int blockY = (pRegion->y / 4 + i) * 4;
+        unsigned int top    = std::max(blockY, pRegion->y);
+        unsigned int nbRows = std::min(bottom - blockY, 4u);
+
+        if (bDirect)
         {
-            *pDst = pHeader->palette[*pIndices];
-            pDst->a = (*pAlpha & (1 << counter) ? 0xFF : 0x00);
+            tBGRAPixel* pRows = blp_sinkRow(pSink, top - pRegion->y, 0);
+            pJob->rowFunction(pSrc, width, nbRows, pRows, pSink->stride);
 
-            ++pIndices;
-            ++pDst;
+            for (unsigned int y = top; bContinue && (y < blockY + nbRows); ++y)
+                bContinue = blp_flushRow(pSink, y - pRegion->y, blp_row(pRows, pSink->stride, y - top), width);
+        }
+        else
+        {
+            pJob->rowFunction(pSrc, width, nbRows, pScratch, stride);
 
-            ++counter;
-            if (counter == 8)
-            {
-                ++pAlpha;
-                counter = 0;
-            }
+            for (unsigned int y = top; bContinue && (y < blockY + nbRows); ++y)
+                bContinue = blp_copyRow(pSink, y - pRegion->y, blp_row(pScratch, stride, y - blockY) + offsetX, pRegion->width);
         }
+
+        pSrc += pJob->rowSize;
     }
 
-    return pBuffer;
-}
+    blp_releaseScratch(pContext, pScratch);
 
-tBGRAPixel* blp2_convert_paletted_alpha4(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
-{
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    // Only possible when streaming (the rows are then decoded by one thread)
+    if (!bContinue)
+        pJob->pAborted[thread] = true;
+}
 
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
-    uint8_t counter = 0;
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pIndices];
-            pDst->a = (*pAlpha >> counter) & 0xF;
+// The blocks are decoded one row of blocks (4 rows of pixels) at a time. The rows
+// of blocks are independent, so large mip levels are split between the threads
+// of the pool (if enabled). When streaming, they must be delivered in order, so
+// the calling thread decodes them all.
+bool blp2_convert_dxt(const uint8_t* pSrc, tDXTRowFunction rowFunction, unsigned int blockSize, unsigned int width, unsigned int /*height*/, const tRegion* pRegion, const tRowSink* pSink)
+{
+    unsigned int rowSize = ((width + 3) / 4) * blockSize;
+    unsigned int nbBlockRows = (pRegion->y + pRegion->height + 3) / 4 - pRegion->y / 4;
 
-            // convert 4-bit range to 8-bit range
-            pDst->a = (pDst->a << 4) | pDst->a;
+    tDXTJob job;
+    job.pSrc        = pSrc + size_t(pRegion->y / 4) * rowSize + (pRegion->x / 4) * blockSize;
+    job.rowFunction = rowFunction;
+    job.rowSize     = rowSize;
+    job.region      = *pRegion;
+    job.pSink       = pSink;
 
-            ++pIndices;
-            ++pDst;
+    // Each thread records its own failure, the flags are combined once all the
+    // rows are processed
+    unsigned int nbThreads = (pSink->callback ? 1 : blp_nbPoolThreads());
+    bool         aborted   = false;
 
-            counter += 4;
-            if (counter == 8)
-            {
-                ++pAlpha;
-                counter = 0;
-            }
-        }
-    }
+    job.pAborted = (nbThreads > 1 ? blp_allocateArray<bool>(nbThreads) : &aborted);
+    if (!job.pAborted)
+        return false;
 
-    return pBuffer;
-}
+    std::fill(job.pAborted, job.pAborted + nbThreads, false);
 
-tBGRAPixel* blp2_convert_raw_bgra(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
-{
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    if (pSink->callback)
+        blp2_convert_dxt_rows(&job, 0, 0, nbBlockRows);
+    else
+        blp_parallelRows(blp2_convert_dxt_rows, &job, nbBlockRows, size_t(pRegion->width) * pRegion->height);
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            pDst->b = pSrc[0];
-            pDst->g = pSrc[1];
-            pDst->r = pSrc[2];
-            pDst->a = pSrc[3];
+    bool bResult = (std::find(job.pAborted, job.pAborted + nbThreads, true) == job.pAborted + nbThreads);
 
-            pSrc += 4;
-            ++pDst;
-        }
-    }
+    if (job.pAborted != &aborted)
+        blp_free(job.pAborted);
 
-    return pBuffer;
+    return bResult;
 }
 
-tBGRAPixel* blp2_convert_dxt(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height, int flags)
+
+// One pixel per block: the image is reduced by 4
+bool blp2_convert_dxt_averages(const uint8_t* pSrc, tDXTAverageFunction averageFunction, unsigned int blockSize, unsigned int nbBlocksX, unsigned int /*nbBlocksY*/, const tRegion* pRegion, const tRowSink* pSink)
 {
-    squish::u8* rgba = new squish::u8[width * height * 4];
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
+    tBGRAPixel* pScratch = (pSink->convert ? blp_scratchRows(pSink->pContext, pRegion->width) : 0);
+    if (pSink->convert && !pScratch)
+        return false;
 
-    squish::u8* pSrc2 = rgba;
-    tBGRAPixel* pDst = pBuffer;
+    bool bResult = true;
 
-    squish::DecompressImage(rgba, width, height, pSrc, flags);
+    pSrc += (size_t(pRegion->y) * nbBlocksX + pRegion->x) * blockSize;
 
-    for (unsigned int y = 0; y < height; ++y)
+    for (unsigned int y = 0; bResult && (y < pRegion->height); ++y)
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            pDst->r = pSrc2[0];
-            pDst->g = pSrc2[1];
-            pDst->b = pSrc2[2];
-            pDst->a = pSrc2[3];
+        tBGRAPixel* pRow = blp_sinkRow(pSink, y, pScratch);
+        averageFunction(pSrc, pRegion->width, pRow);
+        bResult = blp_flushRow(pSink, y, pRow, pRegion->width);
 
-            pSrc2 += 4;
-            ++pDst;
-        }
+        pSrc += nbBlocksX * blockSize;
     }
 
-    delete[] rgba;
+    blp_releaseScratch(pSink->pContext, pScratch);
 
-    return pBuffer;
+    return bResult;
 }
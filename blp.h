@@ -2,6 +2,7 @@
 #define _BLP_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string>
 
@@ -27,7 +28,9 @@ struct tBGRAPixel
     uint8_t a;
 };
 
-// Opaque type representing a BLP file
+// Opaque type representing a BLP file. It is never modified after its creation
+// by blp_processFile() or blp_processMemory(), so several threads can use it
+// at the same time (for instance to convert different mip levels in parallel).
 typedef void* tBLPInfos;
 
 
@@ -75,9 +78,79 @@ enum tBLPFormat
 };
 
 
+// Functions used by the library to allocate and release memory. 'allocFunction'
+// returns 0 when out of memory.
+typedef void* (*tBLPAllocFunction)(size_t size, void* pUserData);
+typedef void (*tBLPFreeFunction)(void* pMemory, void* pUserData);
+
+// Replaces the allocator of the library (by default: new[] and delete[]). All
+// the allocations of libblp go through it, except the internal ones of libjpeg
+// when decoding JPEG images. The memory kept by the library (caches, thread
+// pool) is released first, but the memory held by the caller (results,
+// contexts, tBLPInfos) must be released before the call. No conversion may be
+// running (0 restores the default allocator).
+MODULE_API void blp_setAllocator(tBLPAllocFunction allocFunction, tBLPFreeFunction freeFunction, void* pUserData);
+
+// Releases the buffers returned by the library (blp_convert() & co). delete[] can
+// also be used, but only with the default allocator.
+MODULE_API void blp_free(void* pMemory);
+
+// Releases the memory kept by the library to speed up later conversions (the
+// JPEG decoders primed with the recently used BLP1 headers)
+MODULE_API void blp_releaseCaches();
+
+
 MODULE_API tBLPInfos blp_processFile(FILE* pFile);
+
+// Same as blp_processFile(), but reads the BLP file from a memory buffer. The
+// buffer only needs to be valid during the call.
+MODULE_API tBLPInfos blp_processMemory(const void* pData, size_t size);
+
 MODULE_API void blp_release(tBLPInfos blpInfos);
 
+// Opaque type holding the informations about one BLP file at a time, and scratch
+// buffers growing to the biggest sizes needed so far. Processing and converting
+// many files through the same context (in buffers provided by the caller: see
+// blp_convertInto() & co) doesn't allocate any memory once the buffers are big
+// enough, except inside libjpeg for JPEG images. A context must only be used by
+// one thread at a time.
+typedef void* tBLPContext;
+
+MODULE_API tBLPContext blp_createContext();
+MODULE_API void blp_releaseContext(tBLPContext context);
+
+// Same as blp_processFile() and blp_processMemory(), but the informations are
+// stored in the context, replacing the ones of the previous file. They are valid
+// until the next call with the same context, and must not be released. Their
+// conversions use the scratch buffers of the context, so they can't be done by
+// several threads at once. The multithreaded DXT decoding (see blp_setNbThreads())
+// is still possible, but the other threads allocate their own scratch rows when
+// they need some.
+MODULE_API tBLPInfos blp_processFileInContext(tBLPContext context, FILE* pFile);
+MODULE_API tBLPInfos blp_processMemoryInContext(tBLPContext context, const void* pData, size_t size);
+
+// Informations found in the fixed part of the header of a BLP file
+struct tBLPProbe
+{
+    uint8_t      version;       // 1 or 2 (0: not a BLP file)
+    tBLPFormat   format;
+    unsigned int width;         // Of the first mip level
+    unsigned int height;
+    unsigned int nbMipLevels;
+};
+
+// Lighter alternatives to blp_processFile() and blp_processMemory(), when only
+// the informations above are needed: only the fixed part of the header is read
+// (in one read), and nothing is allocated. Returns false if it isn't a BLP file.
+MODULE_API bool blp_probe(FILE* pFile, tBLPProbe* pProbe);
+MODULE_API bool blp_probeMemory(const void* pData, size_t size, tBLPProbe* pProbe);
+
+// Probes a list of files, each one with a single open/read/close sequence (no
+// FILE* nor buffer allocation). 'pProbes' must have room for 'nbPaths' values;
+// the version of the files that can't be read or aren't BLP files is set to 0.
+// Returns the number of BLP files found.
+MODULE_API size_t blp_probeFiles(const char* const* pPaths, size_t nbPaths, tBLPProbe* pProbes);
+
 MODULE_API uint8_t blp_version(tBLPInfos blpInfos);
 MODULE_API tBLPFormat blp_format(tBLPInfos blpInfos);
 
@@ -85,12 +158,229 @@ MODULE_API unsigned int blp_width(tBLPInfos blpInfos, unsigned int mipLevel = 0)
 MODULE_API unsigned int blp_height(tBLPInfos blpInfos, unsigned int mipLevel = 0);
 MODULE_API unsigned int blp_nbMipLevels(tBLPInfos blpInfos);
 
+// The conversion functions don't use the position of the file when it has a
+// descriptor (the data is mapped in memory or read with positional reads), so
+// the same FILE* can be used by several threads at once. This is also true for
+// the other FILE* (fmemopen(), ...) on POSIX systems, whose reads are serialised
+// by the lock of the FILE*. On Windows, the calls sharing a FILE* must not run
+// at the same time.
 MODULE_API tBGRAPixel* blp_convert(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel = 0);
 
+// Same as blp_convert(), but the pixels are decoded directly from a memory
+// buffer containing the whole BLP file (the one given to blp_processMemory())
+MODULE_API tBGRAPixel* blp_convertMemory(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel = 0);
+
+// Size (in bytes) of the buffer needed to hold a mip level with tightly packed rows
+MODULE_API size_t blp_requiredBufferSize(tBLPInfos blpInfos, unsigned int mipLevel = 0);
+
+// Same as blp_convert() and blp_convertMemory(), but the pixels are written in
+// a buffer provided by the caller. 'dstStride' is the distance in bytes between
+// the start of two consecutive rows (0: rows are tightly packed). It can be
+// negative, to produce bottom-up images: 'pDst' is then the address of the top
+// row, i.e. the last one in memory. Returns false if the mip level can't be
+// converted.
+MODULE_API bool blp_convertInto(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel,
+                                tBGRAPixel* pDst, ptrdiff_t dstStride = 0);
+MODULE_API bool blp_convertMemoryInto(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                                      tBGRAPixel* pDst, ptrdiff_t dstStride = 0);
+
+// Conversion at a reduced size (1/2, 1/4 or 1/8, for thumbnails). JPEG images are
+// scaled by the decoder itself, for a fraction of the cost of a full decoding.
+// The other formats use the smaller mip level of the file, or the smallest one
+// when the file doesn't have enough mip levels. Past the smallest mip level, DXT
+// images can still be reduced by 4, using the average colour of each block.
+// 'scaleDenom' is rounded down to 1, 2, 4 or 8. blp_scaledSize() returns the
+// size of the resulting image.
+MODULE_API void blp_scaledSize(tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                               unsigned int* pWidth, unsigned int* pHeight);
+MODULE_API tBGRAPixel* blp_convertScaled(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom);
+MODULE_API tBGRAPixel* blp_convertMemoryScaled(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                                               unsigned int scaleDenom);
+MODULE_API bool blp_convertScaledInto(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                                      tBGRAPixel* pDst, ptrdiff_t dstStride = 0);
+MODULE_API bool blp_convertMemoryScaledInto(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                                            unsigned int scaleDenom, tBGRAPixel* pDst, ptrdiff_t dstStride = 0);
+
+// Pixel formats of the converted images. The pixels are decoded as BGRA, and
+// converted to the requested format row by row, while still in the cache.
+enum tBLPPixelFormat
+{
+    BLP_PIXEL_FORMAT_BGRA,                  // tBGRAPixel
+    BLP_PIXEL_FORMAT_RGBA,
+    BLP_PIXEL_FORMAT_RGB,                   // 3 bytes per pixel (no alpha)
+    BLP_PIXEL_FORMAT_BGRA_PREMULTIPLIED,    // Colour components multiplied by alpha/255 (rounded)
+    BLP_PIXEL_FORMAT_RGBA_PREMULTIPLIED,
+    BLP_PIXEL_FORMAT_ALPHA,                 // 1 byte per pixel
+};
+
+// Size (in bytes) of one pixel in the given format
+MODULE_API unsigned int blp_pixelSize(tBLPPixelFormat format);
+
+// Same as blp_convertScaledInto() and blp_convertMemoryScaledInto(), but the
+// pixels are written in the given format. 'dstStride' is the distance in bytes
+// between two consecutive rows (0: width * blp_pixelSize(format)).
+MODULE_API bool blp_convertToFormat(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                                    tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride = 0);
+MODULE_API bool blp_convertMemoryToFormat(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                                          unsigned int scaleDenom, tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride = 0);
+
+// Receives 'nbRows' consecutive rows of converted pixels, starting at the row
+// 'y', 'stride' bytes apart. The pixels are only valid during the call. Returning
+// false stops the conversion.
+typedef bool (*tBLPRowsCallback)(void* pUserData, unsigned int y, unsigned int nbRows, const void* pPixels, ptrdiff_t stride);
+
+// Same as blp_convertToFormat() and blp_convertMemoryToFormat(), but the image
+// is delivered to 'callback' from top to bottom, one band at a time: 4 rows for
+// DXT images (one row of blocks), 1 row for the others. Only one band is held in
+// memory, so the image can be consumed incrementally (by an encoder, ...) with
+// a memory usage proportional to its width. DXT images are always decoded by the
+// calling thread. Returns false if the mip level can't be converted, or if the
+// callback stopped the conversion.
+MODULE_API bool blp_convertStream(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                                  tBLPPixelFormat format, tBLPRowsCallback callback, void* pUserData);
+MODULE_API bool blp_convertMemoryStream(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                                        unsigned int scaleDenom, tBLPPixelFormat format, tBLPRowsCallback callback,
+                                        void* pUserData);
+
+// Same as blp_convertToFormat() and blp_convertMemoryToFormat() (at the full
+// size), but only the rectangle of 'width' x 'height' pixels at ('x', 'y') is
+// written in 'pDst'. Only the blocks (DXT) or parts of rows (paletted, raw) it
+// covers are decoded. JPEG images are decoded up to its last row. Returns false
+// if the rectangle is empty or isn't entirely inside the mip level.
+MODULE_API bool blp_convertRegion(FILE* pFile, tBLPInfos blpInfos, unsigned int mipLevel,
+                                  unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                                  tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride = 0);
+MODULE_API bool blp_convertMemoryRegion(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel,
+                                        unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                                        tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride = 0);
+
+// Returns the pixels of a mip level of a BLP_FORMAT_RAW_BGRA image directly from
+// the data of the file (tightly packed rows), without any decoding nor copy.
+// Returns 0 for the other formats, or if the pixels of the mip level aren't all
+// in the buffer. The pixels are only valid as long as the buffer is.
+MODULE_API const tBGRAPixel* blp_viewMemory(const void* pData, size_t size, tBLPInfos blpInfos, unsigned int mipLevel = 0);
+
+// A whole BLP file in memory: mapped when possible, or else read in a buffer.
+// To use with blp_processMemory(), blp_viewMemory() and the conversion
+// functions working on memory buffers.
+struct tBLPMapping
+{
+    const void* pData;
+    size_t      size;
+    void*       pBuffer;    // Internal (set when the file can't be mapped)
+};
+
+// The file can be closed once mapped. Views into the mapping are valid until
+// blp_unmap() is called.
+MODULE_API bool blp_map(FILE* pFile, tBLPMapping* pMapping);
+MODULE_API void blp_unmap(tBLPMapping* pMapping);
+
+// Converts all the mip levels at once, in one contiguous buffer (to release with
+// blp_free()). The offset (in pixels) of each mip level in the buffer is written
+// in 'pOffsets', which must have room for blp_nbMipLevels() values.
+MODULE_API tBGRAPixel* blp_convertAllMips(FILE* pFile, tBLPInfos blpInfos, size_t* pOffsets);
+MODULE_API tBGRAPixel* blp_convertMemoryAllMips(const void* pData, size_t size, tBLPInfos blpInfos, size_t* pOffsets);
+
+// Reads up to 'size' bytes found at 'offset' in the data of a source into 'pDst'.
+// Returns the number of bytes read: less than 'size' only at the end of the data
+// (or on error).
+typedef size_t (*tBLPReadAtFunction)(void* pUserData, size_t offset, void* pDst, size_t size);
+
+// Returns the size of the data of a source
+typedef size_t (*tBLPSizeFunction)(void* pUserData);
+
+// A BLP file stored anywhere (inside an archive, ...), read through callbacks,
+// so it can be decoded without being extracted in a file first. Only the needed
+// parts are read: the header, then the mip levels to convert. When the whole
+// file is already in memory (a buffer, a mapped file, ...), 'pData' can be set
+// instead of the callbacks, to decode it in place. The callbacks can be called
+// by several threads at once when the same source is converted by several
+// threads.
+struct tBLPSource
+{
+    tBLPReadAtFunction readAt;
+    tBLPSizeFunction   size;
+    void*              pUserData;
+
+    const void*        pData;       // 0 to use the callbacks
+    size_t             dataSize;
+};
+
+// Same as the functions working on a FILE* (which are implemented on top of
+// sources, like the ones working on memory buffers)
+MODULE_API tBLPInfos blp_processSource(const tBLPSource* pSource);
+MODULE_API tBLPInfos blp_processSourceInContext(tBLPContext context, const tBLPSource* pSource);
+MODULE_API bool blp_probeSource(const tBLPSource* pSource, tBLPProbe* pProbe);
+MODULE_API tBGRAPixel* blp_convertSource(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel = 0);
+MODULE_API bool blp_convertSourceToFormat(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                                          tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride = 0);
+MODULE_API bool blp_convertSourceStream(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scaleDenom,
+                                        tBLPPixelFormat format, tBLPRowsCallback callback, void* pUserData);
+MODULE_API bool blp_convertSourceRegion(const tBLPSource* pSource, tBLPInfos blpInfos, unsigned int mipLevel,
+                                        unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                                        tBLPPixelFormat format, void* pDst, ptrdiff_t dstStride = 0);
+MODULE_API tBGRAPixel* blp_convertSourceAllMips(const tBLPSource* pSource, tBLPInfos blpInfos, size_t* pOffsets);
+
+// Enables the decoding of large DXT mip levels by several threads at once
+// (disabled by default). 'nbThreads' includes the calling thread, so 0 or 1
+// disables it. Mip levels with less than 'minPixels' pixels are always decoded
+// by the calling thread alone. The same threads convert the files of a batch
+// (see blp_convertBatch()). Must not be called during a conversion.
+MODULE_API void blp_setNbThreads(unsigned int nbThreads, size_t minPixels = 512 * 512);
+
+// One file of a batch: a path, or else a source (see tBLPSource)
+struct tBLPBatchInput
+{
+    const char* pPath;
+    tBLPSource  source;
+};
+
+// The conversion applied to all the files of a batch (see blp_convertToFormat())
+struct tBLPBatchOptions
+{
+    unsigned int    mipLevel;
+    unsigned int    scaleDenom;
+    tBLPPixelFormat format;
+};
+
+// Receives the result of the conversion of the file 'index' of a batch. The
+// pixels are tightly packed rows in the requested format, or 0 if the file can't
+// be read or converted ('blpInfos' is then 0 too if it isn't a BLP file). The
+// pixels and the informations are only valid during the call.
+typedef void (*tBLPBatchCallback)(void* pUserData, size_t index, tBLPInfos blpInfos, const void* pPixels,
+                                  unsigned int width, unsigned int height);
+
+// Converts many files at once. They are distributed one by one between the
+// threads enabled by blp_setNbThreads(), each one reading, processing and
+// converting a whole file, so the reads of some files overlap the decoding of
+// the others. Each thread reuses its own buffers (see tBLPContext) from one file
+// to the next. 'callback' is called once per file, in any order and by any of
+// these threads (possibly at the same time). The files are converted by the
+// calling thread alone when the threads are disabled, or already busy (with
+// another batch, ...). Returns the number of files converted.
+MODULE_API size_t blp_convertBatch(const tBLPBatchInput* pInputs, size_t nbInputs, const tBLPBatchOptions* pOptions,
+                                   tBLPBatchCallback callback, void* pUserData);
+
+
+enum tBLPKernels
+{
+    BLP_KERNELS_SCALAR = 0,
+    BLP_KERNELS_SSE2   = 1,
+    BLP_KERNELS_SSE41  = 2,
+    BLP_KERNELS_AVX2   = 3,
+    BLP_KERNELS_AVX512 = 4,
+};
+
+// Instruction set used by the conversions, selected once from the features of
+// the CPU. The BLP_KERNELS environment variable ("scalar", "sse2", "sse4.1",
+// "avx2" or "avx512") can force a lower one, for benchmarking purposes.
+MODULE_API tBLPKernels blp_getActiveKernels();
+
 #ifdef __cplusplus
 }
 #endif
 
 std::string blp_asString(tBLPFormat format);
+std::string blp_asString(tBLPKernels kernels);
 
 #endif
@@ -1,8 +1,11 @@
 #ifndef _BLP_INTERNAL_H_
 #define _BLP_INTERNAL_H_
 
+#include "blp_kernels.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 
 
@@ -59,10 +62,26 @@ struct tBLP2Header
 };
 
 
+struct tInternalBLPInfos;
+struct tInternalBLPContext;
+struct tRegion;
+struct tRowSink;
+
+
+// Signature of the functions decoding (a region of) a mip level in a sink, one
+// per format of image. 'scale' is the denominator of the scaling done during the
+// decoding, and 'width' x 'height' the resulting size.
+typedef bool (*tMipDecoder)(tInternalBLPInfos* pBLPInfos, const uint8_t* pSrc, uint32_t size, unsigned int scale,
+                            const tBGRAPixel* pPalette, unsigned int width, unsigned int height,
+                            const tRegion* pRegion, const tRowSink* pSink);
+
+
 // Internal representation of any BLP header
 struct tInternalBLPInfos
 {
-    uint8_t version;     // 1 or 2
+    uint8_t              version;   // 1 or 2
+    tMipDecoder          decoder;   // Selected once from the format (0: unsupported)
+    tInternalBLPContext* pContext;  // Owner of the structure and of the scratch buffers (if any)
 
     union {
         struct {
@@ -74,4 +93,131 @@ struct tInternalBLPInfos
     };
 };
 
+
+// Allocates memory with the allocator of the library (see blp_setAllocator()),
+// to release with blp_free(). Returns 0 when out of memory.
+void* blp_allocate(size_t size);
+
+template <typename T>
+inline T* blp_allocateArray(size_t count)
+{
+    return static_cast<T*>(blp_allocate(count * sizeof(T)));
+}
+
+
+// A buffer reused from one conversion to the next, growing to the biggest size
+// requested so far
+struct tScratchBuffer
+{
+    uint8_t* pData;
+    size_t   size;
+};
+
+
+// One scratch buffer per usage, since they can be needed at the same time
+enum tScratchSlot
+{
+    BLP_SCRATCH_SOURCE,     // The file or the mip level, when it can't be mapped
+    BLP_SCRATCH_BAND,       // The rows given to the streaming callback
+    BLP_SCRATCH_ROWS,       // The rows decoded before being converted
+    BLP_SCRATCH_OUTPUT,     // The converted images of a batch
+
+    BLP_NB_SCRATCH_SLOTS
+};
+
+
+// Internal representation of a tBLPContext
+struct tInternalBLPContext
+{
+    tInternalBLPInfos infos;        // Of the last file processed
+    tScratchBuffer    jpegHeader;
+    tScratchBuffer    scratch[BLP_NB_SCRATCH_SLOTS];
+};
+
+
+// Returns the address of a row in a destination buffer
+inline tBGRAPixel* blp_row(tBGRAPixel* pBuffer, ptrdiff_t stride, unsigned int y)
+{
+    return reinterpret_cast<tBGRAPixel*>(reinterpret_cast<uint8_t*>(pBuffer) + ptrdiff_t(y) * stride);
+}
+
+
+// Rectangle of a mip level to decode. The decoded rows start at its top-left
+// corner.
+struct tRegion
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+};
+
+
+// Destination of the decoded pixels. The decoders produce rows of BGRA pixels:
+// they are written directly in the destination buffer when it uses that format,
+// or else in a scratch buffer and converted by 'convert' right away.
+// When streaming, the destination buffer only holds one band of 'bandHeight'
+// rows, given to 'callback' as soon as its last row is written.
+struct tRowSink
+{
+    uint8_t*          pBuffer;
+    ptrdiff_t         stride;
+    tPixelRowFunction convert;      // 0 for BGRA
+
+    tBLPRowsCallback  callback;     // 0 when not streaming
+    void*             pUserData;
+    unsigned int      bandHeight;
+    unsigned int      height;
+
+    tInternalBLPContext* pContext;  // Scratch buffers (0: allocated by each conversion)
+};
+
+
+// Returns the address of the row 'y' in the destination buffer
+inline uint8_t* blp_sinkAddress(const tRowSink* pSink, unsigned int y)
+{
+    if (pSink->callback)
+        y %= pSink->bandHeight;
+
+    return pSink->pBuffer + ptrdiff_t(y) * pSink->stride;
+}
+
+
+// Returns where the decoder must write the row 'y': directly in the destination
+// buffer, or in 'pScratch' (to pass to blp_flushRow() afterwards)
+inline tBGRAPixel* blp_sinkRow(const tRowSink* pSink, unsigned int y, tBGRAPixel* pScratch)
+{
+    if (pSink->convert)
+        return pScratch;
+
+    return reinterpret_cast<tBGRAPixel*>(blp_sinkAddress(pSink, y));
+}
+
+
+// Converts the row 'y' returned by blp_sinkRow() into the destination format (if
+// needed). When streaming, delivers the band once its last row is done. Returns
+// false if the callback asked to stop the decoding.
+inline bool blp_flushRow(const tRowSink* pSink, unsigned int y, const tBGRAPixel* pRow, unsigned int width)
+{
+    if (pSink->convert)
+        pSink->convert(pRow, blp_sinkAddress(pSink, y), width);
+
+    if (!pSink->callback || (((y + 1) % pSink->bandHeight != 0) && (y + 1 != pSink->height)))
+        return true;
+
+    unsigned int first = y - y % pSink->bandHeight;
+    return pSink->callback(pSink->pUserData, first, y + 1 - first, pSink->pBuffer, pSink->stride);
+}
+
+// Writes the row 'y' from pixels already decoded elsewhere (in the data of the
+// file, in a bigger scratch buffer, ...). Returns false if the callback asked
+// to stop the decoding.
+inline bool blp_copyRow(const tRowSink* pSink, unsigned int y, const tBGRAPixel* pRow, unsigned int width)
+{
+    if (!pSink->convert)
+        memcpy(blp_sinkAddress(pSink, y), pRow, width * sizeof(tBGRAPixel));
+
+    return blp_flushRow(pSink, y, pRow, width);
+}
+
 #endif
@@ -0,0 +1,570 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include <string.h>
+#include <setjmp.h>
+#include <LibJPEG/jpeglib.h>
+
+#ifndef _WIN32
+#   include <pthread.h>
+#endif
+
+
+// libjpeg source manager reading the JPEG stream from two memory segments: the
+// header of the image, then the data of the mip level
+struct tJPEGSource
+{
+    jpeg_source_mgr pub;
+
+    const uint8_t*  pSegments[2];
+    size_t          sizes[2];
+    unsigned int    nextSegment;
+};
+
+
+static void blp_jpeg_init_source(j_decompress_ptr /*cinfo*/)
+{
+}
+
+
+static boolean blp_jpeg_fill_input_buffer(j_decompress_ptr cinfo)
+{
+    tJPEGSource* pSource = reinterpret_cast<tJPEGSource*>(cinfo->src);
+
+    while (pSource->nextSegment < 2)
+    {
+        unsigned int segment = pSource->nextSegment++;
+
+        if (pSource->sizes[segment] > 0)
+        {
+            pSource->pub.next_input_byte = pSource->pSegments[segment];
+            pSource->pub.bytes_in_buffer = pSource->sizes[segment];
+            return TRUE;
+        }
+    }
+
+    // Truncated stream: insert a fake EOI marker, so the decoder returns what it
+    // could decode (like FreeImage did)
+    static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+
+    pSource->pub.next_input_byte = eoi;
+    pSource->pub.bytes_in_buffer = 2;
+
+    return TRUE;
+}
+
+
+static void blp_jpeg_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    tJPEGSource* pSource = reinterpret_cast<tJPEGSource*>(cinfo->src);
+
+    if (num_bytes <= 0)
+        return;
+
+    while (size_t(num_bytes) > pSource->pub.bytes_in_buffer)
+    {
+        num_bytes -= long(pSource->pub.bytes_in_buffer);
+        blp_jpeg_fill_input_buffer(cinfo);
+    }
+
+    pSource->pub.next_input_byte += num_bytes;
+    pSource->pub.bytes_in_buffer -= num_bytes;
+}
+
+
+static void blp_jpeg_term_source(j_decompress_ptr /*cinfo*/)
+{
+}
+
+
+// libjpeg error manager returning to the last call to setjmp() on fatal errors
+struct tJPEGErrorManager
+{
+    jpeg_error_mgr  pub;
+    jmp_buf         jump;
+};
+
+
+static void blp_jpeg_error_exit(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<tJPEGErrorManager*>(cinfo->err)->jump, 1);
+}
+
+
+static void blp_jpeg_output_message(j_common_ptr /*cinfo*/)
+{
+}
+
+
+// Converts a scanline decoded by libjpeg into BGRA pixels. The source may be
+// located in the destination row itself, at the offset '(4 - components) * width'
+// bytes: each pixel is read before being overwritten, and never overwrites the
+// pixels still to be read.
+static void blp_jpeg_expand_scanline(const uint8_t* pSrc, J_COLOR_SPACE colorSpace, int components, unsigned int width, tBGRAPixel* pDst)
+{
+    // R and B are inverted in the JPEG file: the first component is the blue one
+    if (components == 1)
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            uint8_t value = pSrc[x];
+
+            pDst[x].b = value;
+            pDst[x].g = value;
+            pDst[x].r = value;
+            pDst[x].a = 0xFF;
+        }
+    }
+    else if ((components == 4) && (colorSpace == JCS_CMYK))
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            unsigned int k = pSrc[3];
+
+            tBGRAPixel pixel;
+            pixel.b = (k * pSrc[0]) / 255;
+            pixel.g = (k * pSrc[1]) / 255;
+            pixel.r = (k * pSrc[2]) / 255;
+            pixel.a = 0xFF;
+
+            pDst[x] = pixel;
+            pSrc += 4;
+        }
+    }
+    else
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            tBGRAPixel pixel;
+            pixel.b = pSrc[0];
+            pixel.g = pSrc[1];
+            pixel.r = pSrc[2];
+            pixel.a = 0xFF;
+
+            pDst[x] = pixel;
+            pSrc += components;
+        }
+    }
+}
+
+
+// A decompressor primed with the quantization and Huffman tables of a JPEG
+// header. All the mip levels of a BLP1 file (and often several files) share the
+// same header, so the tables are only parsed once, and the decompressor only has
+// to read the rest of the header and the scan data of each mip level.
+struct tJPEGContext
+{
+    jpeg_decompress_struct  cinfo;
+    tJPEGErrorManager       jerr;
+    tJPEGSource             source;
+
+    uint8_t*                pHeader;            // Copy of the header (used to find the context of a file)
+    uint32_t                headerSize;
+
+    uint8_t*                pImageHeader;       // The header without the tables (starting with SOI)
+    uint32_t                imageHeaderSize;
+
+    // The tables loaded from the header, to detect a mip level overriding them
+    JQUANT_TBL*             quantTables[NUM_QUANT_TBLS];
+    JHUFF_TBL*              dcTables[NUM_HUFF_TBLS];
+    JHUFF_TBL*              acTables[NUM_HUFF_TBLS];
+    JQUANT_TBL              quantValues[NUM_QUANT_TBLS];
+    JHUFF_TBL               dcValues[NUM_HUFF_TBLS];
+    JHUFF_TBL               acValues[NUM_HUFF_TBLS];
+
+    tJPEGContext*           pNext;
+};
+
+
+// Maximum number of idle contexts kept for later decodings
+static const unsigned int BLP_JPEG_CACHE_SIZE = 8;
+
+#ifndef _WIN32
+static pthread_mutex_t jpegCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static tJPEGContext* pJPEGCache = 0;
+#endif
+
+
+// Splits a JPEG header in a tables-only stream (SOI, DQT and DHT segments, EOI),
+// and the rest of the header. The other markers (APPn, DRI, ...) are reset by
+// the SOI of each image, so they stay in the rest. Returns false if the header
+// doesn't start with SOI.
+static bool blp_jpeg_split_header(const uint8_t* pHeader, uint32_t headerSize,
+                                  uint8_t* pTables, uint32_t* pTablesSize,
+                                  uint8_t* pImageHeader, uint32_t* pImageHeaderSize)
+{
+    if ((headerSize < 2) || (pHeader[0] != 0xFF) || (pHeader[1] != 0xD8))    // SOI
+        return false;
+
+    uint32_t tablesSize = 2;
+    uint32_t imageHeaderSize = 2;
+    uint32_t offset = 2;
+
+    pTables[0] = pImageHeader[0] = 0xFF;
+    pTables[1] = pImageHeader[1] = 0xD8;
+
+    // Stops at the first marker without length (SOI, EOI, RSTn, ...) or at the
+    // start of the scan (SOS)
+    while (offset + 4 <= headerSize)
+    {
+        uint8_t marker = pHeader[offset + 1];
+
+        if ((pHeader[offset] != 0xFF) || (marker == 0xFF) || (marker == 0x01) || (marker == 0xDA) ||
+            ((marker >= 0xD0) && (marker <= 0xD9)))
+        {
+            break;
+        }
+
+        uint32_t length = 2 + ((pHeader[offset + 2] << 8) | pHeader[offset + 3]);
+        if (length > headerSize - offset)
+            break;
+
+        if ((marker == 0xDB) || (marker == 0xC4))   // DQT, DHT
+        {
+            memcpy(pTables + tablesSize, pHeader + offset, length);
+            tablesSize += length;
+        }
+        else
+        {
+            memcpy(pImageHeader + imageHeaderSize, pHeader + offset, length);
+            imageHeaderSize += length;
+        }
+
+        offset += length;
+    }
+
+    memcpy(pImageHeader + imageHeaderSize, pHeader + offset, headerSize - offset);
+    imageHeaderSize += headerSize - offset;
+
+    pTables[tablesSize] = 0xFF;
+    pTables[tablesSize + 1] = JPEG_EOI;
+    tablesSize += 2;
+
+    *pTablesSize = tablesSize;
+    *pImageHeaderSize = imageHeaderSize;
+
+    return true;
+}
+
+
+static void blp_jpeg_destroy_context(tJPEGContext* pContext)
+{
+    jpeg_destroy_decompress(&pContext->cinfo);
+
+    blp_free(pContext->pHeader);
+    blp_free(pContext->pImageHeader);
+    blp_free(pContext);
+}
+
+
+// Creates a new context for a JPEG header. If the tables can't be loaded from
+// the header, the context is still usable, but isn't primed. Returns 0 when out
+// of memory.
+static tJPEGContext* blp_jpeg_create_context(const uint8_t* pHeader, uint32_t headerSize)
+{
+    tJPEGContext* pContext = blp_allocateArray<tJPEGContext>(1);
+    if (!pContext)
+        return 0;
+
+    memset(pContext, 0, sizeof(tJPEGContext));
+
+    uint8_t* pTables = blp_allocateArray<uint8_t>(headerSize + 2);
+    pContext->pHeader = blp_allocateArray<uint8_t>(headerSize);
+    pContext->pImageHeader = blp_allocateArray<uint8_t>(headerSize);
+
+    if (!pTables || !pContext->pHeader || !pContext->pImageHeader)
+    {
+        blp_free(pTables);
+        blp_free(pContext->pHeader);
+        blp_free(pContext->pImageHeader);
+        blp_free(pContext);
+        return 0;
+    }
+
+    pContext->headerSize = headerSize;
+    if (headerSize > 0)
+        memcpy(pContext->pHeader, pHeader, headerSize);
+
+    pContext->cinfo.err = jpeg_std_error(&pContext->jerr.pub);
+    pContext->jerr.pub.error_exit     = blp_jpeg_error_exit;
+    pContext->jerr.pub.output_message = blp_jpeg_output_message;
+
+    pContext->source.pub.init_source       = blp_jpeg_init_source;
+    pContext->source.pub.fill_input_buffer = blp_jpeg_fill_input_buffer;
+    pContext->source.pub.skip_input_data   = blp_jpeg_skip_input_data;
+    pContext->source.pub.resync_to_restart = jpeg_resync_to_restart;
+    pContext->source.pub.term_source       = blp_jpeg_term_source;
+
+    jpeg_create_decompress(&pContext->cinfo);
+    pContext->cinfo.src = &pContext->source.pub;
+
+    uint32_t tablesSize = 0;
+
+    bool bPrimed = blp_jpeg_split_header(pHeader, headerSize, pTables, &tablesSize,
+                                         pContext->pImageHeader, &pContext->imageHeaderSize);
+
+    if (bPrimed)
+    {
+        if (setjmp(pContext->jerr.jump))
+        {
+            // Start again from a clean decompressor
+            jpeg_destroy_decompress(&pContext->cinfo);
+            jpeg_create_decompress(&pContext->cinfo);
+            pContext->cinfo.src = &pContext->source.pub;
+            bPrimed = false;
+        }
+        else
+        {
+            pContext->source.pSegments[0] = pTables;
+            pContext->source.sizes[0]     = tablesSize;
+            pContext->source.pSegments[1] = 0;
+            pContext->source.sizes[1]     = 0;
+            pContext->source.nextSegment  = 0;
+            pContext->source.pub.bytes_in_buffer = 0;
+
+            bPrimed = (jpeg_read_header(&pContext->cinfo, FALSE) == JPEG_HEADER_TABLES_ONLY);
+        }
+    }
+
+    blp_free(pTables);
+
+    if (bPrimed)
+    {
+        for (unsigned int i = 0; i < NUM_QUANT_TBLS; ++i)
+        {
+            pContext->quantTables[i] = pContext->cinfo.quant_tbl_ptrs[i];
+            if (pContext->quantTables[i])
+                pContext->quantValues[i] = *pContext->quantTables[i];
+        }
+
+        for (unsigned int i = 0; i < NUM_HUFF_TBLS; ++i)
+        {
+            pContext->dcTables[i] = pContext->cinfo.dc_huff_tbl_ptrs[i];
+            if (pContext->dcTables[i])
+                pContext->dcValues[i] = *pContext->dcTables[i];
+
+            pContext->acTables[i] = pContext->cinfo.ac_huff_tbl_ptrs[i];
+            if (pContext->acTables[i])
+                pContext->acValues[i] = *pContext->acTables[i];
+        }
+    }
+    else
+    {
+        // Unprimed: the whole header is read for each mip level
+        if (headerSize > 0)
+            memcpy(pContext->pImageHeader, pHeader, headerSize);
+        pContext->imageHeaderSize = headerSize;
+    }
+
+    return pContext;
+}
+
+
+// Indicates if the tables of a context are still the ones loaded from the
+// header (a mip level may have overridden them)
+static bool blp_jpeg_check_tables(tJPEGContext* pContext)
+{
+    for (unsigned int i = 0; i < NUM_QUANT_TBLS; ++i)
+    {
+        JQUANT_TBL* pTable = pContext->cinfo.quant_tbl_ptrs[i];
+
+        if ((pTable != pContext->quantTables[i]) ||
+            (pTable && memcmp(pTable->quantval, pContext->quantValues[i].quantval, sizeof(pTable->quantval)) != 0))
+        {
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < NUM_HUFF_TBLS; ++i)
+    {
+        JHUFF_TBL* pTables[2]    = { pContext->cinfo.dc_huff_tbl_ptrs[i], pContext->cinfo.ac_huff_tbl_ptrs[i] };
+        JHUFF_TBL* pExpected[2]  = { pContext->dcTables[i], pContext->acTables[i] };
+        JHUFF_TBL* pValues[2]    = { &pContext->dcValues[i], &pContext->acValues[i] };
+
+        for (unsigned int j = 0; j < 2; ++j)
+        {
+            if ((pTables[j] != pExpected[j]) ||
+                (pTables[j] && ((memcmp(pTables[j]->bits, pValues[j]->bits, sizeof(pTables[j]->bits)) != 0) ||
+                                (memcmp(pTables[j]->huffval, pValues[j]->huffval, sizeof(pTables[j]->huffval)) != 0))))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Returns a context for a JPEG header, from the cache if possible
+static tJPEGContext* blp_jpeg_acquire_context(const uint8_t* pHeader, uint32_t headerSize)
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&jpegCacheMutex);
+
+    tJPEGContext** ppContext = &pJPEGCache;
+    while (*ppContext)
+    {
+        tJPEGContext* pContext = *ppContext;
+
+        if ((pContext->headerSize == headerSize) && ((headerSize == 0) || (memcmp(pContext->pHeader, pHeader, headerSize) == 0)))
+        {
+            *ppContext = pContext->pNext;
+            pContext->pNext = 0;
+
+            pthread_mutex_unlock(&jpegCacheMutex);
+            return pContext;
+        }
+
+        ppContext = &pContext->pNext;
+    }
+
+    pthread_mutex_unlock(&jpegCacheMutex);
+#endif
+
+    return blp_jpeg_create_context(pHeader, headerSize);
+}
+
+
+// Gives a context back to the cache (the least recently used one is destroyed
+// if the cache is full). Contexts that can't be reused are destroyed.
+static void blp_jpeg_release_context(tJPEGContext* pContext, bool bReusable)
+{
+    tJPEGContext* pDestroyed = pContext;
+
+#ifndef _WIN32
+    if (bReusable && blp_jpeg_check_tables(pContext))
+    {
+        pthread_mutex_lock(&jpegCacheMutex);
+
+        pContext->pNext = pJPEGCache;
+        pJPEGCache = pContext;
+
+        pDestroyed = 0;
+
+        tJPEGContext** ppContext = &pJPEGCache;
+        for (unsigned int i = 0; *ppContext && (i < BLP_JPEG_CACHE_SIZE); ++i)
+            ppContext = &(*ppContext)->pNext;
+
+        if (*ppContext)
+        {
+            pDestroyed = *ppContext;
+            *ppContext = 0;
+        }
+
+        pthread_mutex_unlock(&jpegCacheMutex);
+    }
+#endif
+
+    if (pDestroyed)
+        blp_jpeg_destroy_context(pDestroyed);
+}
+
+
+// Destroys the idle contexts of the cache
+void blp_jpeg_release_cache()
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&jpegCacheMutex);
+
+    tJPEGContext* pContext = pJPEGCache;
+    pJPEGCache = 0;
+
+    pthread_mutex_unlock(&jpegCacheMutex);
+
+    while (pContext)
+    {
+        tJPEGContext* pNext = pContext->pNext;
+        blp_jpeg_destroy_context(pContext);
+        pContext = pNext;
+    }
+#endif
+}
+
+
+// The JPEG stream is decoded directly from the header and the mip level data,
+// with the same settings than FreeImage used (fast integer IDCT, no fancy
+// upsampling). The scanlines are decoded in the destination rows (or in a
+// scratch row, when the destination isn't in BGRA), and expanded to BGRA in
+// place. With a 'scaleDenom' greater than 1, libjpeg reduces the image during
+// the IDCT ('width' and 'height' are then the reduced size). The scanlines can't
+// be skipped: the ones above the region are decoded and discarded, and the
+// decoding stops after its last one.
+bool blp1_convert_jpeg(const uint8_t* pSrc, tBLP1Infos* pInfos, uint32_t size, unsigned int scaleDenom, unsigned int width, unsigned int height,
+                       const tRegion* pRegion, const tRowSink* pSink)
+{
+    tJPEGContext* pContext = blp_jpeg_acquire_context(pInfos->jpeg.header, pInfos->jpeg.headerSize);
+    if (!pContext)
+        return false;
+
+    jpeg_decompress_struct* cinfo = &pContext->cinfo;
+
+    if (setjmp(pContext->jerr.jump))
+    {
+        blp_jpeg_release_context(pContext, false);
+        return false;
+    }
+
+    pContext->source.pSegments[0] = pContext->pImageHeader;
+    pContext->source.sizes[0]     = pContext->imageHeaderSize;
+    pContext->source.pSegments[1] = pSrc;
+    pContext->source.sizes[1]     = size;
+    pContext->source.nextSegment  = 0;
+    pContext->source.pub.next_input_byte = 0;
+    pContext->source.pub.bytes_in_buffer = 0;
+
+    jpeg_read_header(cinfo, TRUE);
+
+    cinfo->dct_method          = JDCT_IFAST;
+    cinfo->do_fancy_upsampling = FALSE;
+    cinfo->scale_num           = 1;
+    cinfo->scale_denom         = scaleDenom;
+
+    jpeg_start_decompress(cinfo);
+
+    // The JPEG image must at least cover the mip level
+    int components = cinfo->output_components;
+    bool bResult = (cinfo->output_width >= width) && (cinfo->output_height >= height) &&
+                   ((components == 1) || (components == 3) || (components == 4));
+
+    if (bResult)
+    {
+        unsigned int regionWidth = pRegion->width;
+
+        // When the JPEG image is wider than the region, its scanlines don't fit
+        // in the destination rows
+        JSAMPARRAY scanline = 0;
+        if ((cinfo->output_width > regionWidth) || (pRegion->y > 0))
+            scanline = (*cinfo->mem->alloc_sarray)(reinterpret_cast<j_common_ptr>(cinfo), JPOOL_IMAGE, cinfo->output_width * components, 1);
+
+        tBGRAPixel* pScratch = 0;
+        if (pSink->convert)
+            pScratch = reinterpret_cast<tBGRAPixel*>((*cinfo->mem->alloc_large)(reinterpret_cast<j_common_ptr>(cinfo), JPOOL_IMAGE, regionWidth * sizeof(tBGRAPixel)));
+
+        for (unsigned int y = 0; y < pRegion->y; ++y)
+            jpeg_read_scanlines(cinfo, scanline, 1);
+
+        for (unsigned int y = 0; y < pRegion->height; ++y)
+        {
+            tBGRAPixel* pDst = blp_sinkRow(pSink, y, pScratch);
+
+            JSAMPROW row = (scanline ? scanline[0] : reinterpret_cast<JSAMPROW>(pDst) + (4 - components) * regionWidth);
+            jpeg_read_scanlines(cinfo, &row, 1);
+
+            blp_jpeg_expand_scanline(row + pRegion->x * components, cinfo->out_color_space, components, regionWidth, pDst);
+
+            if (!blp_flushRow(pSink, y, pDst, regionWidth))
+            {
+                bResult = false;
+                break;
+            }
+        }
+    }
+
+    // The remaining scanlines (if any, or when the streaming was stopped) are
+    // simply discarded. Aborting keeps the tables, so the context can be reused.
+    jpeg_abort_decompress(cinfo);
+
+    blp_jpeg_release_context(pContext, true);
+
+    return bResult;
+}
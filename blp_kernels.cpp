@@ -0,0 +1,680 @@
+#include "blp_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+const tPaletteKernels BLP_PALETTE_KERNELS_SCALAR = {
+    blp_palette_no_alpha,
+    blp_palette_alpha1,
+    blp_palette_alpha4,
+    blp_palette_alpha8,
+    blp_palette_palette_alpha,
+};
+
+
+const tDXTKernels BLP_DXT_KERNELS_SCALAR = {
+    blp_dxt1_row,
+    blp_dxt3_row,
+    blp_dxt5_row,
+    blp_dxt1_average_row,
+    blp_dxt3_average_row,
+    blp_dxt5_average_row,
+};
+
+
+const tPixelFormatKernels BLP_PIXEL_FORMAT_KERNELS_SCALAR = {
+    blp_to_rgba,
+    blp_to_rgb,
+    blp_to_bgra_premultiplied,
+    blp_to_rgba_premultiplied,
+    blp_to_alpha,
+};
+
+
+// Returns the best instruction set supported by the CPU, or the one forced by
+// the BLP_KERNELS environment variable (if lower)
+static tBLPKernels blp_detectKernels()
+{
+#if BLP_X86_KERNELS
+    __builtin_cpu_init();
+
+    tBLPKernels kernels = (__builtin_cpu_supports("avx512f") ? BLP_KERNELS_AVX512 :
+                           __builtin_cpu_supports("avx2")    ? BLP_KERNELS_AVX2 :
+                           __builtin_cpu_supports("sse4.1")  ? BLP_KERNELS_SSE41 :
+                           __builtin_cpu_supports("sse2")    ? BLP_KERNELS_SSE2 :
+                                                               BLP_KERNELS_SCALAR);
+
+    const char* pOverride = getenv("BLP_KERNELS");
+    if (pOverride)
+    {
+        static const char* NAMES[] = { "scalar", "sse2", "sse4.1", "avx2", "avx512" };
+
+        for (int i = 0; i < int(sizeof(NAMES) / sizeof(NAMES[0])); ++i)
+        {
+            if ((strcmp(pOverride, NAMES[i]) == 0) && (i < kernels))
+                kernels = tBLPKernels(i);
+        }
+    }
+
+    return kernels;
+#else
+    return BLP_KERNELS_SCALAR;
+#endif
+}
+
+
+tBLPKernels blp_getActiveKernels()
+{
+    static const tBLPKernels kernels = blp_detectKernels();
+    return kernels;
+}
+
+
+std::string blp_asString(tBLPKernels kernels)
+{
+    switch (kernels)
+    {
+        case BLP_KERNELS_SCALAR: return "Scalar";
+        case BLP_KERNELS_SSE2:   return "SSE2";
+        case BLP_KERNELS_SSE41:  return "SSE4.1";
+        case BLP_KERNELS_AVX2:   return "AVX2";
+        case BLP_KERNELS_AVX512: return "AVX-512";
+        default:                 return "Unknown";
+    }
+}
+
+
+const tPaletteKernels* blp_paletteKernels()
+{
+#if BLP_X86_KERNELS
+    static const tPaletteKernels* const KERNELS[] = {
+        &BLP_PALETTE_KERNELS_SCALAR,
+        &BLP_PALETTE_KERNELS_SSE2,
+        &BLP_PALETTE_KERNELS_SSE41,
+        &BLP_PALETTE_KERNELS_AVX2,
+        &BLP_PALETTE_KERNELS_AVX512,
+    };
+
+    return KERNELS[blp_getActiveKernels()];
+#else
+    return &BLP_PALETTE_KERNELS_SCALAR;
+#endif
+}
+
+
+const tDXTKernels* blp_dxtKernels()
+{
+#if BLP_X86_KERNELS
+    // The SIMD DXT decoders need at least SSE4.1 (pshufb, pblendvb), and there is
+    // no AVX-512 one (the AVX2 decoder is used instead)
+    static const tDXTKernels* const KERNELS[] = {
+        &BLP_DXT_KERNELS_SCALAR,
+        &BLP_DXT_KERNELS_SCALAR,
+        &BLP_DXT_KERNELS_SSE41,
+        &BLP_DXT_KERNELS_AVX2,
+        &BLP_DXT_KERNELS_AVX2,
+    };
+
+    return KERNELS[blp_getActiveKernels()];
+#else
+    return &BLP_DXT_KERNELS_SCALAR;
+#endif
+}
+
+
+const tPixelFormatKernels* blp_pixelFormatKernels()
+{
+#if BLP_X86_KERNELS
+    // The SIMD conversions need at least SSE4.1 (pshufb), and don't have any use
+    // for AVX-512
+    static const tPixelFormatKernels* const KERNELS[] = {
+        &BLP_PIXEL_FORMAT_KERNELS_SCALAR,
+        &BLP_PIXEL_FORMAT_KERNELS_SCALAR,
+        &BLP_PIXEL_FORMAT_KERNELS_SSE41,
+        &BLP_PIXEL_FORMAT_KERNELS_AVX2,
+        &BLP_PIXEL_FORMAT_KERNELS_AVX2,
+    };
+
+    return KERNELS[blp_getActiveKernels()];
+#else
+    return &BLP_PIXEL_FORMAT_KERNELS_SCALAR;
+#endif
+}
+
+
+// Sources of the alpha channel of the paletted images. Each one returns the alpha
+// of the pixel 'i' of the alpha plane, or computes it from the alpha of the
+// palette entry.
+struct tAlphaNone
+{
+    static inline uint8_t alpha(const uint8_t* /*pAlpha*/, size_t /*i*/, uint8_t /*paletteAlpha*/) { return 0xFF; }
+};
+
+struct tAlpha1Bit
+{
+    static inline uint8_t alpha(const uint8_t* pAlpha, size_t i, uint8_t /*paletteAlpha*/)
+    {
+        return uint8_t(0 - ((pAlpha[i / 8] >> (i % 8)) & 0x1));
+    }
+};
+
+struct tAlpha4Bits
+{
+    static inline uint8_t alpha(const uint8_t* pAlpha, size_t i, uint8_t /*paletteAlpha*/)
+    {
+        // convert 4-bit range to 8-bit range
+        uint8_t value = (pAlpha[i / 2] >> ((i % 2) * 4)) & 0xF;
+        return (value << 4) | value;
+    }
+};
+
+struct tAlpha8Bits
+{
+    static inline uint8_t alpha(const uint8_t* pAlpha, size_t i, uint8_t /*paletteAlpha*/) { return pAlpha[i]; }
+};
+
+struct tAlphaFromPalette
+{
+    static inline uint8_t alpha(const uint8_t* /*pAlpha*/, size_t /*i*/, uint8_t paletteAlpha) { return 0xFF - paletteAlpha; }
+};
+
+
+template <class tAlphaSource>
+static inline void blp_palette_row(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                   size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        pDst[i] = pPalette[pIndices[i]];
+        pDst[i].a = tAlphaSource::alpha(pAlpha, alphaStart + i, pDst[i].a);
+    }
+}
+
+
+void blp_palette_no_alpha(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    blp_palette_row<tAlphaNone>(pPalette, pIndices, pAlpha, alphaStart, pDst, count);
+}
+
+
+void blp_palette_alpha1(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    blp_palette_row<tAlpha1Bit>(pPalette, pIndices, pAlpha, alphaStart, pDst, count);
+}
+
+
+void blp_palette_alpha4(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    blp_palette_row<tAlpha4Bits>(pPalette, pIndices, pAlpha, alphaStart, pDst, count);
+}
+
+
+void blp_palette_alpha8(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    blp_palette_row<tAlpha8Bits>(pPalette, pIndices, pAlpha, alphaStart, pDst, count);
+}
+
+
+void blp_palette_palette_alpha(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    blp_palette_row<tAlphaFromPalette>(pPalette, pIndices, pAlpha, alphaStart, pDst, count);
+}
+
+
+/************************************ DXT *************************************/
+
+// The DXT decoding produces exactly the same pixels than squish::Decompress()
+
+// Converts a 5:6:5 colour to BGRA
+static inline tBGRAPixel blp_unpack565(uint16_t value)
+{
+    uint8_t red   = (value >> 11) & 0x1F;
+    uint8_t green = (value >> 5) & 0x3F;
+    uint8_t blue  = value & 0x1F;
+
+    tBGRAPixel colour;
+    colour.r = (red << 3) | (red >> 2);
+    colour.g = (green << 2) | (green >> 4);
+    colour.b = (blue << 3) | (blue >> 2);
+    colour.a = 0xFF;
+
+    return colour;
+}
+
+
+// Computes the 4 colours of the palette of a DXT colour block (8 bytes)
+static inline void blp_dxt_codes(const uint8_t* pBlock, bool isDxt1, tBGRAPixel* pCodes)
+{
+    uint16_t a = pBlock[0] | (pBlock[1] << 8);
+    uint16_t b = pBlock[2] | (pBlock[3] << 8);
+
+    pCodes[0] = blp_unpack565(a);
+    pCodes[1] = blp_unpack565(b);
+
+    if (isDxt1 && (a <= b))
+    {
+        pCodes[2].b = (pCodes[0].b + pCodes[1].b) / 2;
+        pCodes[2].g = (pCodes[0].g + pCodes[1].g) / 2;
+        pCodes[2].r = (pCodes[0].r + pCodes[1].r) / 2;
+        pCodes[2].a = 0xFF;
+
+        pCodes[3].b = 0;
+        pCodes[3].g = 0;
+        pCodes[3].r = 0;
+        pCodes[3].a = 0;
+    }
+    else
+    {
+        pCodes[2].b = (2 * pCodes[0].b + pCodes[1].b) / 3;
+        pCodes[2].g = (2 * pCodes[0].g + pCodes[1].g) / 3;
+        pCodes[2].r = (2 * pCodes[0].r + pCodes[1].r) / 3;
+        pCodes[2].a = 0xFF;
+
+        pCodes[3].b = (pCodes[0].b + 2 * pCodes[1].b) / 3;
+        pCodes[3].g = (pCodes[0].g + 2 * pCodes[1].g) / 3;
+        pCodes[3].r = (pCodes[0].r + 2 * pCodes[1].r) / 3;
+        pCodes[3].a = 0xFF;
+    }
+}
+
+
+// Decodes the colour part of a DXT block (8 bytes)
+static inline void blp_dxt_colours(const uint8_t* pBlock, bool isDxt1, tBGRAPixel* pPixels)
+{
+    tBGRAPixel codes[4];
+    blp_dxt_codes(pBlock, isDxt1, codes);
+
+    uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | (uint32_t(pBlock[7]) << 24);
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        pPixels[i] = codes[indices & 0x3];
+        indices >>= 2;
+    }
+}
+
+
+// Decodes the explicit alpha of a DXT3 block (8 bytes)
+static inline void blp_dxt3_alpha(const uint8_t* pBlock, tBGRAPixel* pPixels)
+{
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        uint8_t low  = pBlock[i] & 0x0F;
+        uint8_t high = pBlock[i] & 0xF0;
+
+        pPixels[2 * i].a     = low | (low << 4);
+        pPixels[2 * i + 1].a = high | (high >> 4);
+    }
+}
+
+
+// Computes the 8 alpha values of the codebook of a DXT5 block
+static inline void blp_dxt5_codes(const uint8_t* pBlock, uint8_t* pCodes)
+{
+    int alpha0 = pBlock[0];
+    int alpha1 = pBlock[1];
+
+    pCodes[0] = alpha0;
+    pCodes[1] = alpha1;
+
+    if (alpha0 <= alpha1)
+    {
+        for (int i = 1; i < 5; ++i)
+            pCodes[1 + i] = ((5 - i) * alpha0 + i * alpha1) / 5;
+
+        pCodes[6] = 0;
+        pCodes[7] = 0xFF;
+    }
+    else
+    {
+        for (int i = 1; i < 7; ++i)
+            pCodes[1 + i] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    }
+}
+
+
+// Returns the 48 bits of alpha indices of a DXT5 block
+static inline uint64_t blp_dxt5_indices(const uint8_t* pBlock)
+{
+    uint64_t indices = 0;
+    for (unsigned int i = 0; i < 6; ++i)
+        indices |= uint64_t(pBlock[2 + i]) << (8 * i);
+
+    return indices;
+}
+
+
+// Decodes the interpolated alpha of a DXT5 block (8 bytes)
+static inline void blp_dxt5_alpha(const uint8_t* pBlock, tBGRAPixel* pPixels)
+{
+    uint8_t codes[8];
+    blp_dxt5_codes(pBlock, codes);
+
+    uint64_t indices = blp_dxt5_indices(pBlock);
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        pPixels[i].a = codes[indices & 0x7];
+        indices >>= 3;
+    }
+}
+
+
+// Writes the 16 pixels of a block, clipped to the image
+static inline void blp_dxt_store(const tBGRAPixel* pPixels, unsigned int nbColumns, unsigned int nbRows,
+                                 tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    for (unsigned int y = 0; y < nbRows; ++y)
+    {
+        memcpy(pDst, pPixels + 4 * y, nbColumns * sizeof(tBGRAPixel));
+        pDst = reinterpret_cast<tBGRAPixel*>(reinterpret_cast<uint8_t*>(pDst) + stride);
+    }
+}
+
+
+// Decodes a row of blocks ('tBlock' is the encoding: see below)
+template <class tBlock>
+static inline void blp_dxt_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    tBGRAPixel pixels[16];
+
+    for (unsigned int x = 0; x < width; x += 4)
+    {
+        tBlock::decode(pBlocks, pixels);
+        blp_dxt_store(pixels, (width - x < 4 ? width - x : 4), nbRows, pDst + x, stride);
+
+        pBlocks += tBlock::SIZE;
+    }
+}
+
+
+/******************************* DXT averages *********************************/
+
+// The averages are computed from the palette of each block and the number of
+// pixels using each of its entries, without decoding the pixels. They are
+// exact (rounded to the nearest integer).
+
+// Number of bits set in a 32-bit value
+static inline unsigned int blp_popcount(uint32_t value)
+{
+    value = value - ((value >> 1) & 0x55555555);
+    value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+    return (((value + (value >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+
+// Computes the average of the colour part of a DXT block (8 bytes)
+static inline tBGRAPixel blp_dxt_average_colour(const uint8_t* pBlock, bool isDxt1)
+{
+    tBGRAPixel codes[4];
+    blp_dxt_codes(pBlock, isDxt1, codes);
+
+    // Count the 2-bit indices with each value
+    uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | (uint32_t(pBlock[7]) << 24);
+    uint32_t low  = indices & 0x55555555;
+    uint32_t high = (indices >> 1) & 0x55555555;
+
+    unsigned int counts[4];
+    counts[3] = blp_popcount(low & high);
+    counts[2] = blp_popcount(high & ~low);
+    counts[1] = blp_popcount(low & ~high);
+    counts[0] = 16 - counts[1] - counts[2] - counts[3];
+
+    unsigned int b = 8, g = 8, r = 8, a = 8;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        b += counts[i] * codes[i].b;
+        g += counts[i] * codes[i].g;
+        r += counts[i] * codes[i].r;
+        a += counts[i] * codes[i].a;
+    }
+
+    tBGRAPixel average;
+    average.b = b >> 4;
+    average.g = g >> 4;
+    average.r = r >> 4;
+    average.a = a >> 4;
+
+    return average;
+}
+
+
+// Computes the average of the explicit alpha of a DXT3 block (8 bytes)
+static inline uint8_t blp_dxt3_average_alpha(const uint8_t* pBlock)
+{
+    // Each 4-bit value v is expanded to v * 17
+    unsigned int sum = 0;
+    for (unsigned int j = 0; j < 8; ++j)
+        sum += (pBlock[j] & 0x0F) + (pBlock[j] >> 4);
+
+    return (sum * 17 + 8) >> 4;
+}
+
+
+// Computes the average of the interpolated alpha of a DXT5 block (8 bytes)
+static inline uint8_t blp_dxt5_average_alpha(const uint8_t* pBlock)
+{
+    uint8_t codes[8];
+    blp_dxt5_codes(pBlock, codes);
+
+    uint64_t indices = blp_dxt5_indices(pBlock);
+
+    unsigned int sum = 8;
+    for (unsigned int j = 0; j < 16; ++j)
+    {
+        sum += codes[indices & 0x7];
+        indices >>= 3;
+    }
+
+    return sum >> 4;
+}
+
+
+// Computes the average colour of each block of a row ('tBlock': see below)
+template <class tBlock>
+static inline void blp_dxt_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    for (unsigned int i = 0; i < nbBlocks; ++i)
+    {
+        pDst[i] = tBlock::average(pBlocks);
+        pBlocks += tBlock::SIZE;
+    }
+}
+
+
+/******************************* DXT encodings ********************************/
+
+// One structure per DXT encoding, to specialise blp_dxt_row<>() and
+// blp_dxt_average_row<>()
+struct tDXT1Block
+{
+    enum { SIZE = 8 };
+
+    static inline void decode(const uint8_t* pBlock, tBGRAPixel* pPixels)
+    {
+        blp_dxt_colours(pBlock, true, pPixels);
+    }
+
+    static inline tBGRAPixel average(const uint8_t* pBlock)
+    {
+        return blp_dxt_average_colour(pBlock, true);
+    }
+};
+
+
+struct tDXT3Block
+{
+    enum { SIZE = 16 };
+
+    static inline void decode(const uint8_t* pBlock, tBGRAPixel* pPixels)
+    {
+        blp_dxt_colours(pBlock + 8, false, pPixels);
+        blp_dxt3_alpha(pBlock, pPixels);
+    }
+
+    static inline tBGRAPixel average(const uint8_t* pBlock)
+    {
+        tBGRAPixel average = blp_dxt_average_colour(pBlock + 8, false);
+        average.a = blp_dxt3_average_alpha(pBlock);
+        return average;
+    }
+};
+
+
+struct tDXT5Block
+{
+    enum { SIZE = 16 };
+
+    static inline void decode(const uint8_t* pBlock, tBGRAPixel* pPixels)
+    {
+        blp_dxt_colours(pBlock + 8, false, pPixels);
+        blp_dxt5_alpha(pBlock, pPixels);
+    }
+
+    static inline tBGRAPixel average(const uint8_t* pBlock)
+    {
+        tBGRAPixel average = blp_dxt_average_colour(pBlock + 8, false);
+        average.a = blp_dxt5_average_alpha(pBlock);
+        return average;
+    }
+};
+
+
+void blp_dxt1_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    blp_dxt_row<tDXT1Block>(pBlocks, width, nbRows, pDst, stride);
+}
+
+
+void blp_dxt3_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    blp_dxt_row<tDXT3Block>(pBlocks, width, nbRows, pDst, stride);
+}
+
+
+void blp_dxt5_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    blp_dxt_row<tDXT5Block>(pBlocks, width, nbRows, pDst, stride);
+}
+
+
+void blp_dxt1_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    blp_dxt_average_row<tDXT1Block>(pBlocks, nbBlocks, pDst);
+}
+
+
+void blp_dxt3_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    blp_dxt_average_row<tDXT3Block>(pBlocks, nbBlocks, pDst);
+}
+
+
+void blp_dxt5_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    blp_dxt_average_row<tDXT5Block>(pBlocks, nbBlocks, pDst);
+}
+
+
+/******************************* Pixel formats ********************************/
+
+// Multiplies a colour component by alpha/255, rounded to the nearest integer
+static inline uint8_t blp_premultiply(unsigned int value, unsigned int alpha)
+{
+    unsigned int product = value * alpha + 128;
+    return uint8_t((product + (product >> 8)) >> 8);
+}
+
+
+// Writes a pixel in the given format, and returns the address of the next one
+template <tBLPPixelFormat FORMAT>
+static inline uint8_t* blp_storePixel(tBGRAPixel pixel, uint8_t* pDst);
+
+
+template <>
+inline uint8_t* blp_storePixel<BLP_PIXEL_FORMAT_RGBA>(tBGRAPixel pixel, uint8_t* pDst)
+{
+    pDst[0] = pixel.r;
+    pDst[1] = pixel.g;
+    pDst[2] = pixel.b;
+    pDst[3] = pixel.a;
+    return pDst + 4;
+}
+
+
+template <>
+inline uint8_t* blp_storePixel<BLP_PIXEL_FORMAT_RGB>(tBGRAPixel pixel, uint8_t* pDst)
+{
+    pDst[0] = pixel.r;
+    pDst[1] = pixel.g;
+    pDst[2] = pixel.b;
+    return pDst + 3;
+}
+
+
+template <>
+inline uint8_t* blp_storePixel<BLP_PIXEL_FORMAT_BGRA_PREMULTIPLIED>(tBGRAPixel pixel, uint8_t* pDst)
+{
+    pDst[0] = blp_premultiply(pixel.b, pixel.a);
+    pDst[1] = blp_premultiply(pixel.g, pixel.a);
+    pDst[2] = blp_premultiply(pixel.r, pixel.a);
+    pDst[3] = pixel.a;
+    return pDst + 4;
+}
+
+
+template <>
+inline uint8_t* blp_storePixel<BLP_PIXEL_FORMAT_RGBA_PREMULTIPLIED>(tBGRAPixel pixel, uint8_t* pDst)
+{
+    pDst[0] = blp_premultiply(pixel.r, pixel.a);
+    pDst[1] = blp_premultiply(pixel.g, pixel.a);
+    pDst[2] = blp_premultiply(pixel.b, pixel.a);
+    pDst[3] = pixel.a;
+    return pDst + 4;
+}
+
+
+template <>
+inline uint8_t* blp_storePixel<BLP_PIXEL_FORMAT_ALPHA>(tBGRAPixel pixel, uint8_t* pDst)
+{
+    pDst[0] = pixel.a;
+    return pDst + 1;
+}
+
+
+template <tBLPPixelFormat FORMAT>
+static inline void blp_to_format(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+        pDst = blp_storePixel<FORMAT>(pSrc[i], pDst);
+}
+
+
+void blp_to_rgba(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    blp_to_format<BLP_PIXEL_FORMAT_RGBA>(pSrc, pDst, count);
+}
+
+
+void blp_to_rgb(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    blp_to_format<BLP_PIXEL_FORMAT_RGB>(pSrc, pDst, count);
+}
+
+
+void blp_to_bgra_premultiplied(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    blp_to_format<BLP_PIXEL_FORMAT_BGRA_PREMULTIPLIED>(pSrc, pDst, count);
+}
+
+
+void blp_to_rgba_premultiplied(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    blp_to_format<BLP_PIXEL_FORMAT_RGBA_PREMULTIPLIED>(pSrc, pDst, count);
+}
+
+
+void blp_to_alpha(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    blp_to_format<BLP_PIXEL_FORMAT_ALPHA>(pSrc, pDst, count);
+}
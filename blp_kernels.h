@@ -0,0 +1,124 @@
+#ifndef _BLP_KERNELS_H_
+#define _BLP_KERNELS_H_
+
+#include "blp.h"
+#include <stddef.h>
+#include <stdint.h>
+
+
+// SIMD implementations are only available for x86 CPUs, with compilers
+// supporting per-function target attributes
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#   define BLP_X86_KERNELS 1
+#else
+#   define BLP_X86_KERNELS 0
+#endif
+
+
+// Signature of the functions expanding a row of palette indices into BGRA
+// pixels. When the image has an alpha plane, the alpha of the pixel 'i' of the
+// row is the entry 'alphaStart + i' of that plane.
+typedef void (*tPaletteRowFunction)(const tBGRAPixel* pPalette, const uint8_t* pIndices,
+                                    const uint8_t* pAlpha, size_t alphaStart,
+                                    tBGRAPixel* pDst, unsigned int count);
+
+
+// One row function per way of computing the alpha channel
+struct tPaletteKernels
+{
+    tPaletteRowFunction noAlpha;        // Opaque pixels
+    tPaletteRowFunction alpha1;         // 1-bit alpha plane
+    tPaletteRowFunction alpha4;         // 4-bit alpha plane
+    tPaletteRowFunction alpha8;         // 8-bit alpha plane
+    tPaletteRowFunction paletteAlpha;   // Inverted alpha of the palette (BLP1)
+};
+
+
+// Signature of the functions decoding a row of DXT blocks into BGRA pixels.
+// Only the first 'width' columns and 'nbRows' rows (at most 4) are written.
+typedef void (*tDXTRowFunction)(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows,
+                                tBGRAPixel* pDst, ptrdiff_t stride);
+
+
+// Signature of the functions computing the average colour of each block of a
+// row of DXT blocks (one pixel per block)
+typedef void (*tDXTAverageFunction)(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst);
+
+
+// One row function and one average function per DXT encoding
+struct tDXTKernels
+{
+    tDXTRowFunction     dxt1;
+    tDXTRowFunction     dxt3;
+    tDXTRowFunction     dxt5;
+
+    tDXTAverageFunction dxt1Average;
+    tDXTAverageFunction dxt3Average;
+    tDXTAverageFunction dxt5Average;
+};
+
+
+// Signature of the functions converting a row of BGRA pixels into another pixel
+// format (see tBLPPixelFormat)
+typedef void (*tPixelRowFunction)(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count);
+
+
+// One row function per output pixel format (but BGRA, which needs no conversion)
+struct tPixelFormatKernels
+{
+    tPixelRowFunction rgba;
+    tPixelRowFunction rgb;
+    tPixelRowFunction bgraPremultiplied;
+    tPixelRowFunction rgbaPremultiplied;
+    tPixelRowFunction alpha;
+};
+
+
+// Return the implementations matching blp_getActiveKernels()
+const tPaletteKernels* blp_paletteKernels();
+const tDXTKernels* blp_dxtKernels();
+const tPixelFormatKernels* blp_pixelFormatKernels();
+
+
+// Portable implementations, also used as reference
+extern const tPaletteKernels BLP_PALETTE_KERNELS_SCALAR;
+
+void blp_palette_no_alpha(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count);
+void blp_palette_alpha1(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count);
+void blp_palette_alpha4(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count);
+void blp_palette_alpha8(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count);
+void blp_palette_palette_alpha(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha, size_t alphaStart, tBGRAPixel* pDst, unsigned int count);
+
+extern const tDXTKernels BLP_DXT_KERNELS_SCALAR;
+
+void blp_dxt1_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride);
+void blp_dxt3_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride);
+void blp_dxt5_row(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride);
+
+void blp_dxt1_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst);
+void blp_dxt3_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst);
+void blp_dxt5_average_row(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst);
+
+extern const tPixelFormatKernels BLP_PIXEL_FORMAT_KERNELS_SCALAR;
+
+void blp_to_rgba(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count);
+void blp_to_rgb(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count);
+void blp_to_bgra_premultiplied(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count);
+void blp_to_rgba_premultiplied(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count);
+void blp_to_alpha(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count);
+
+
+#if BLP_X86_KERNELS
+extern const tPaletteKernels BLP_PALETTE_KERNELS_SSE2;
+extern const tPaletteKernels BLP_PALETTE_KERNELS_SSE41;
+extern const tPaletteKernels BLP_PALETTE_KERNELS_AVX2;
+extern const tPaletteKernels BLP_PALETTE_KERNELS_AVX512;
+
+extern const tDXTKernels BLP_DXT_KERNELS_SSE41;
+extern const tDXTKernels BLP_DXT_KERNELS_AVX2;
+
+extern const tPixelFormatKernels BLP_PIXEL_FORMAT_KERNELS_SSE41;
+extern const tPixelFormatKernels BLP_PIXEL_FORMAT_KERNELS_AVX2;
+#endif
+
+#endif
@@ -0,0 +1,1754 @@
+#include "blp_kernels.h"
+
+#if BLP_X86_KERNELS
+
+#include <immintrin.h>
+#include <string.h>
+
+
+// The functions below are compiled for a specific instruction set, and only
+// called when the CPU supports it (see blp_getActiveKernels()). Each level may
+// use the helpers of the lower ones, since the instruction sets are supersets of
+// each other.
+#define BLP_TARGET_SSE2   __attribute__((target("sse2")))
+#define BLP_TARGET_SSE41  __attribute__((target("sse4.1")))
+#define BLP_TARGET_AVX2   __attribute__((target("avx2")))
+#define BLP_TARGET_AVX512 __attribute__((target("avx512f")))
+
+
+// Returns the 16 bits of a 1-bit alpha plane starting at the pixel 'start'
+static inline uint32_t blp_load_alpha1(const uint8_t* pAlpha, size_t start)
+{
+    const uint8_t* pBytes = pAlpha + start / 8;
+    unsigned int shift = start % 8;
+
+    // The third byte is only read when needed, to not read past the plane
+    uint32_t bits = pBytes[0] | (pBytes[1] << 8);
+    if (shift != 0)
+        bits |= (pBytes[2] << 16);
+
+    return bits >> shift;
+}
+
+
+// Returns the 16 nibbles of a 4-bit alpha plane starting at the pixel 'start'
+static inline uint64_t blp_load_alpha4(const uint8_t* pAlpha, size_t start)
+{
+    const uint8_t* pBytes = pAlpha + start / 2;
+
+    uint64_t nibbles;
+    memcpy(&nibbles, pBytes, sizeof(nibbles));
+
+    if (start % 2 != 0)
+        nibbles = (nibbles >> 4) | (uint64_t(pBytes[8]) << 60);
+
+    return nibbles;
+}
+
+
+/************************************ SSE2 ************************************/
+
+// Looks up 4 palette entries
+BLP_TARGET_SSE2 static inline __m128i blp_lookup4_sse2(const int* pTable, const uint8_t* pIndices)
+{
+    return _mm_setr_epi32(pTable[pIndices[0]], pTable[pIndices[1]], pTable[pIndices[2]], pTable[pIndices[3]]);
+}
+
+
+// Moves the first 4 bytes of a register into the alpha bytes of 4 pixels
+BLP_TARGET_SSE2 static inline __m128i blp_spread_alpha_sse2(__m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(zero, _mm_unpacklo_epi8(zero, alpha));
+}
+
+
+// Expands 4 8-bit alpha values into the alpha bytes of 4 pixels
+BLP_TARGET_SSE2 static inline __m128i blp_alpha4_sse2(const uint8_t* pAlpha)
+{
+    int32_t alpha;
+    memcpy(&alpha, pAlpha, sizeof(alpha));
+    return blp_spread_alpha_sse2(_mm_cvtsi32_si128(alpha));
+}
+
+
+BLP_TARGET_SSE2 static void blp_palette_no_alpha_sse2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                      size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m128i opaque = _mm_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i colours0 = blp_lookup4_sse2(pTable, pIndices + i);
+        __m128i colours1 = blp_lookup4_sse2(pTable, pIndices + i + 4);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_or_si128(colours0, opaque));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_or_si128(colours1, opaque));
+    }
+
+    blp_palette_no_alpha(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_SSE2 static void blp_palette_alpha8_sse2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                    size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m128i colourMask = _mm_set1_epi32(int(0x00FFFFFF));
+    const uint8_t* pAlpha2 = pAlpha + alphaStart;
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i colours0 = _mm_and_si128(blp_lookup4_sse2(pTable, pIndices + i), colourMask);
+        __m128i colours1 = _mm_and_si128(blp_lookup4_sse2(pTable, pIndices + i + 4), colourMask);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_or_si128(colours0, blp_alpha4_sse2(pAlpha2 + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_or_si128(colours1, blp_alpha4_sse2(pAlpha2 + i + 4)));
+    }
+
+    blp_palette_alpha8(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_SSE2 static void blp_palette_palette_alpha_sse2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                           size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i colours0 = blp_lookup4_sse2(pTable, pIndices + i);
+        __m128i colours1 = blp_lookup4_sse2(pTable, pIndices + i + 4);
+
+        // 0xFF - alpha
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_xor_si128(colours0, alphaMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_xor_si128(colours1, alphaMask));
+    }
+
+    blp_palette_palette_alpha(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+// Expands 16 bits into 16 alpha bytes (0x00 or 0xFF)
+BLP_TARGET_SSE2 static inline __m128i blp_expand_alpha1_sse2(uint32_t bits)
+{
+    const __m128i bitMask = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    // Copies the first byte into the lower 8 bytes, and the second one into the upper 8
+    __m128i alpha = _mm_cvtsi32_si128(bits);
+    alpha = _mm_unpacklo_epi8(alpha, alpha);
+    alpha = _mm_unpacklo_epi16(alpha, alpha);
+    alpha = _mm_unpacklo_epi32(alpha, alpha);
+
+    return _mm_cmpeq_epi8(_mm_and_si128(alpha, bitMask), bitMask);
+}
+
+
+// Expands 16 nibbles into 16 alpha bytes (converted to the 8-bit range)
+BLP_TARGET_SSE2 static inline __m128i blp_expand_alpha4_sse2(uint64_t nibbles)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&nibbles));
+    __m128i low    = _mm_and_si128(packed, nibbleMask);
+    __m128i high   = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+    __m128i alpha  = _mm_unpacklo_epi8(low, high);
+
+    return _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));
+}
+
+
+// Writes 16 pixels, combining the colours from the palette with 16 alpha bytes
+BLP_TARGET_SSE2 static inline void blp_merge16_sse2(const int* pTable, const uint8_t* pIndices, __m128i alpha, tBGRAPixel* pDst)
+{
+    const __m128i colourMask = _mm_set1_epi32(int(0x00FFFFFF));
+
+    for (int j = 0; j < 4; ++j)
+    {
+        __m128i colours = _mm_and_si128(blp_lookup4_sse2(pTable, pIndices + 4 * j), colourMask);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4 * j), _mm_or_si128(colours, blp_spread_alpha_sse2(alpha)));
+
+        alpha = _mm_srli_si128(alpha, 4);
+    }
+}
+
+
+BLP_TARGET_SSE2 static void blp_palette_alpha1_sse2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                    size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+        blp_merge16_sse2(pTable, pIndices + i, blp_expand_alpha1_sse2(blp_load_alpha1(pAlpha, alphaStart + i)), pDst + i);
+
+    blp_palette_alpha1(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_SSE2 static void blp_palette_alpha4_sse2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                    size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+        blp_merge16_sse2(pTable, pIndices + i, blp_expand_alpha4_sse2(blp_load_alpha4(pAlpha, alphaStart + i)), pDst + i);
+
+    blp_palette_alpha4(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+const tPaletteKernels BLP_PALETTE_KERNELS_SSE2 = {
+    blp_palette_no_alpha_sse2,
+    blp_palette_alpha1_sse2,
+    blp_palette_alpha4_sse2,
+    blp_palette_alpha8_sse2,
+    blp_palette_palette_alpha_sse2,
+};
+
+
+/*********************************** SSE4.1 ***********************************/
+
+// Looks up 4 palette entries
+BLP_TARGET_SSE41 static inline __m128i blp_lookup4_sse41(const int* pTable, const uint8_t* pIndices)
+{
+    __m128i colours = _mm_cvtsi32_si128(pTable[pIndices[0]]);
+    colours = _mm_insert_epi32(colours, pTable[pIndices[1]], 1);
+    colours = _mm_insert_epi32(colours, pTable[pIndices[2]], 2);
+    return _mm_insert_epi32(colours, pTable[pIndices[3]], 3);
+}
+
+
+// Expands 4 8-bit alpha values into the alpha bytes of 4 pixels
+BLP_TARGET_SSE41 static inline __m128i blp_alpha4_sse41(const uint8_t* pAlpha)
+{
+    int32_t alpha;
+    memcpy(&alpha, pAlpha, sizeof(alpha));
+    return _mm_slli_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(alpha)), 24);
+}
+
+
+BLP_TARGET_SSE41 static void blp_palette_no_alpha_sse41(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                        size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m128i opaque = _mm_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i colours0 = blp_lookup4_sse41(pTable, pIndices + i);
+        __m128i colours1 = blp_lookup4_sse41(pTable, pIndices + i + 4);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_or_si128(colours0, opaque));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_or_si128(colours1, opaque));
+    }
+
+    blp_palette_no_alpha(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_SSE41 static void blp_palette_alpha8_sse41(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                      size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m128i colourMask = _mm_set1_epi32(int(0x00FFFFFF));
+    const uint8_t* pAlpha2 = pAlpha + alphaStart;
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i colours0 = _mm_and_si128(blp_lookup4_sse41(pTable, pIndices + i), colourMask);
+        __m128i colours1 = _mm_and_si128(blp_lookup4_sse41(pTable, pIndices + i + 4), colourMask);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_or_si128(colours0, blp_alpha4_sse41(pAlpha2 + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_or_si128(colours1, blp_alpha4_sse41(pAlpha2 + i + 4)));
+    }
+
+    blp_palette_alpha8(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_SSE41 static void blp_palette_palette_alpha_sse41(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                             size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i colours0 = blp_lookup4_sse41(pTable, pIndices + i);
+        __m128i colours1 = blp_lookup4_sse41(pTable, pIndices + i + 4);
+
+        // 0xFF - alpha
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_xor_si128(colours0, alphaMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_xor_si128(colours1, alphaMask));
+    }
+
+    blp_palette_palette_alpha(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+// Expands 16 bits into 16 alpha bytes (0x00 or 0xFF)
+BLP_TARGET_SSE41 static inline __m128i blp_expand_alpha1_sse41(uint32_t bits)
+{
+    const __m128i broadcast = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i bitMask   = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m128i alpha = _mm_shuffle_epi8(_mm_cvtsi32_si128(bits), broadcast);
+    return _mm_cmpeq_epi8(_mm_and_si128(alpha, bitMask), bitMask);
+}
+
+
+// Writes 16 pixels, combining the colours from the palette with 16 alpha bytes
+BLP_TARGET_SSE41 static inline void blp_merge16_sse41(const int* pTable, const uint8_t* pIndices, __m128i alpha, tBGRAPixel* pDst)
+{
+    const __m128i colourMask = _mm_set1_epi32(int(0x00FFFFFF));
+
+    for (int j = 0; j < 4; ++j)
+    {
+        __m128i colours = _mm_and_si128(blp_lookup4_sse41(pTable, pIndices + 4 * j), colourMask);
+        __m128i alpha4  = _mm_slli_epi32(_mm_cvtepu8_epi32(alpha), 24);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4 * j), _mm_or_si128(colours, alpha4));
+
+        alpha = _mm_srli_si128(alpha, 4);
+    }
+}
+
+
+BLP_TARGET_SSE41 static void blp_palette_alpha1_sse41(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                      size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+        blp_merge16_sse41(pTable, pIndices + i, blp_expand_alpha1_sse41(blp_load_alpha1(pAlpha, alphaStart + i)), pDst + i);
+
+    blp_palette_alpha1(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_SSE41 static void blp_palette_alpha4_sse41(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                      size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+        blp_merge16_sse41(pTable, pIndices + i, blp_expand_alpha4_sse2(blp_load_alpha4(pAlpha, alphaStart + i)), pDst + i);
+
+    blp_palette_alpha4(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+const tPaletteKernels BLP_PALETTE_KERNELS_SSE41 = {
+    blp_palette_no_alpha_sse41,
+    blp_palette_alpha1_sse41,
+    blp_palette_alpha4_sse41,
+    blp_palette_alpha8_sse41,
+    blp_palette_palette_alpha_sse41,
+};
+
+
+/******************************** DXT (SSE4.1) ********************************/
+
+// The DXT functions below work on registers holding a whole block, with the
+// colour part in the upper 8 bytes (and the alpha part, if any, in the lower
+// ones). They produce exactly the same pixels than the portable decoder.
+
+// Returns the 4 colours of the palette of a DXT colour block
+BLP_TARGET_SSE41 static inline __m128i blp_dxt_palette_sse41(__m128i block, bool isDxt1)
+{
+    // Both endpoints, with one 16-bit lane per channel
+    __m128i endpoints = _mm_shuffle_epi8(block, _mm_setr_epi8(8, 9, 8, 9, 8, 9, -1, -1, 10, 11, 10, 11, 10, 11, -1, -1));
+
+    // Expand the 5:6:5 channels to 8 bits, by replicating their upper bits
+    __m128i fields  = _mm_and_si128(endpoints, _mm_setr_epi16(0x001F, 0x07E0, int16_t(0xF800), 0, 0x001F, 0x07E0, int16_t(0xF800), 0));
+    __m128i aligned = _mm_mullo_epi16(fields, _mm_setr_epi16(2048, 32, 1, 0, 2048, 32, 1, 0));
+    __m128i colours = _mm_or_si128(_mm_srli_epi16(aligned, 8), _mm_mulhi_epu16(aligned, _mm_setr_epi16(8, 4, 8, 0, 8, 4, 8, 0)));
+    colours = _mm_or_si128(colours, _mm_setr_epi16(0, 0, 0, 0xFF, 0, 0, 0, 0xFF));
+
+    // Interpolated colours: (2*c0 + c1) / 3 and (c0 + 2*c1) / 3 (x / 3 == (x * 0xAAAB) >> 17)
+    __m128i swapped = _mm_shuffle_epi32(colours, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i sum     = _mm_add_epi16(colours, swapped);
+    __m128i thirds  = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(sum, colours), _mm_set1_epi16(int16_t(0xAAAB))), 1);
+
+    if (!isDxt1)
+        return _mm_packus_epi16(colours, thirds);
+
+    // DXT1 blocks with c0 <= c1: (c0 + c1) / 2 and transparent black
+    __m128i c0 = _mm_shuffle_epi8(block, _mm_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9));
+    __m128i c1 = _mm_shuffle_epi8(block, _mm_setr_epi8(10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11));
+    __m128i threeColours = _mm_cmpeq_epi16(_mm_max_epu16(c0, c1), c1);
+
+    __m128i halves = _mm_and_si128(_mm_srli_epi16(sum, 1), _mm_setr_epi16(-1, -1, -1, -1, 0, 0, 0, 0));
+
+    return _mm_packus_epi16(colours, _mm_blendv_epi8(thirds, halves, threeColours));
+}
+
+
+// Returns the 16 colour indices of a DXT colour block (one per byte), multiplied
+// by 4 (the offset of the colours in the palette)
+BLP_TARGET_SSE41 static inline __m128i blp_dxt_colour_indices_sse41(__m128i block)
+{
+    // Each 16-bit lane gets the byte containing the index of its pixel, the
+    // multiplication then moves the index at bits 10-11
+    const __m128i shifts = _mm_setr_epi16(1024, 256, 64, 16, 1024, 256, 64, 16);
+
+    __m128i low  = _mm_shuffle_epi8(block, _mm_setr_epi8(12, -1, 12, -1, 12, -1, 12, -1, 13, -1, 13, -1, 13, -1, 13, -1));
+    __m128i high = _mm_shuffle_epi8(block, _mm_setr_epi8(14, -1, 14, -1, 14, -1, 14, -1, 15, -1, 15, -1, 15, -1, 15, -1));
+
+    low  = _mm_srli_epi16(_mm_mullo_epi16(low, shifts), 8);
+    high = _mm_srli_epi16(_mm_mullo_epi16(high, shifts), 8);
+
+    return _mm_and_si128(_mm_packus_epi16(low, high), _mm_set1_epi8(0x0C));
+}
+
+
+// Decodes the colour part of a DXT block into 4 rows of pixels
+BLP_TARGET_SSE41 static inline void blp_dxt_colours_sse41(__m128i block, bool isDxt1, __m128i* pRows)
+{
+    const __m128i channels = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+
+    __m128i palette = blp_dxt_palette_sse41(block, isDxt1);
+    __m128i indices = blp_dxt_colour_indices_sse41(block);
+
+    pRows[0] = _mm_shuffle_epi8(palette, _mm_or_si128(_mm_shuffle_epi8(indices, _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3)), channels));
+    pRows[1] = _mm_shuffle_epi8(palette, _mm_or_si128(_mm_shuffle_epi8(indices, _mm_setr_epi8(4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7)), channels));
+    pRows[2] = _mm_shuffle_epi8(palette, _mm_or_si128(_mm_shuffle_epi8(indices, _mm_setr_epi8(8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11)), channels));
+    pRows[3] = _mm_shuffle_epi8(palette, _mm_or_si128(_mm_shuffle_epi8(indices, _mm_setr_epi8(12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15)), channels));
+}
+
+
+// Replaces the alpha of 4 rows of pixels by 16 alpha bytes
+BLP_TARGET_SSE41 static inline void blp_dxt_merge_alpha_sse41(__m128i alpha, __m128i* pRows)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+
+    pRows[0] = _mm_blendv_epi8(pRows[0], _mm_shuffle_epi8(alpha, _mm_setr_epi8(-1, -1, -1, 0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3)), alphaMask);
+    pRows[1] = _mm_blendv_epi8(pRows[1], _mm_shuffle_epi8(alpha, _mm_setr_epi8(-1, -1, -1, 4, -1, -1, -1, 5, -1, -1, -1, 6, -1, -1, -1, 7)), alphaMask);
+    pRows[2] = _mm_blendv_epi8(pRows[2], _mm_shuffle_epi8(alpha, _mm_setr_epi8(-1, -1, -1, 8, -1, -1, -1, 9, -1, -1, -1, 10, -1, -1, -1, 11)), alphaMask);
+    pRows[3] = _mm_blendv_epi8(pRows[3], _mm_shuffle_epi8(alpha, _mm_setr_epi8(-1, -1, -1, 12, -1, -1, -1, 13, -1, -1, -1, 14, -1, -1, -1, 15)), alphaMask);
+}
+
+
+// Returns the 16 explicit alpha values of a DXT3 block
+BLP_TARGET_SSE41 static inline __m128i blp_dxt3_alpha_sse41(__m128i block)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+    __m128i low   = _mm_and_si128(block, nibbleMask);
+    __m128i high  = _mm_and_si128(_mm_srli_epi16(block, 4), nibbleMask);
+    __m128i alpha = _mm_unpacklo_epi8(low, high);
+
+    return _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));
+}
+
+
+// Returns the 16 interpolated alpha values of a DXT5 block
+BLP_TARGET_SSE41 static inline __m128i blp_dxt5_alpha_sse41(__m128i block)
+{
+    __m128i alpha0 = _mm_shuffle_epi8(block, _mm_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1));
+    __m128i alpha1 = _mm_shuffle_epi8(block, _mm_setr_epi8(1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1));
+
+    // 8-alpha codebook: ((7 - i) * alpha0 + i * alpha1) / 7 (x / 7 == (x * 9363) >> 16)
+    __m128i sum7   = _mm_add_epi16(_mm_mullo_epi16(alpha0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+                                   _mm_mullo_epi16(alpha1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+    __m128i codes7 = _mm_mulhi_epu16(sum7, _mm_set1_epi16(9363));
+
+    // 6-alpha codebook: ((5 - i) * alpha0 + i * alpha1) / 5, 0 and 255 (x / 5 == (x * 13108) >> 16)
+    __m128i sum5   = _mm_add_epi16(_mm_mullo_epi16(alpha0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+                                   _mm_mullo_epi16(alpha1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+    __m128i codes5 = _mm_or_si128(_mm_mulhi_epu16(sum5, _mm_set1_epi16(13108)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0xFF));
+
+    __m128i use5  = _mm_cmpeq_epi16(_mm_max_epu16(alpha0, alpha1), alpha1);
+    __m128i codes = _mm_blendv_epi8(codes7, codes5, use5);
+    codes = _mm_packus_epi16(codes, codes);
+
+    // Each 16-bit lane gets the two bytes containing the index of its pixel,
+    // the multiplication then moves the index at bits 8-10
+    const __m128i shifts = _mm_setr_epi16(256, 32, 4, 128, 16, 2, 64, 8);
+
+    __m128i low  = _mm_shuffle_epi8(block, _mm_setr_epi8(2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 4, 5, 4, 5));
+    __m128i high = _mm_shuffle_epi8(block, _mm_setr_epi8(5, 6, 5, 6, 5, 6, 6, 7, 6, 7, 6, 7, 7, 8, 7, 8));
+
+    low  = _mm_srli_epi16(_mm_mullo_epi16(low, shifts), 8);
+    high = _mm_srli_epi16(_mm_mullo_epi16(high, shifts), 8);
+
+    __m128i indices = _mm_and_si128(_mm_packus_epi16(low, high), _mm_set1_epi8(0x07));
+
+    return _mm_shuffle_epi8(codes, indices);
+}
+
+
+// Writes 4 rows of pixels of a block, clipped to the image
+BLP_TARGET_SSE41 static inline void blp_dxt_store_sse41(const __m128i* pRows, unsigned int nbColumns, unsigned int nbRows,
+                                                        tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    uint8_t* pDst2 = reinterpret_cast<uint8_t*>(pDst);
+
+    if ((nbColumns == 4) && (nbRows == 4))
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst2), pRows[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst2 + stride), pRows[1]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst2 + 2 * stride), pRows[2]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst2 + 3 * stride), pRows[3]);
+        return;
+    }
+
+    tBGRAPixel pixels[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), pRows[0]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4), pRows[1]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 8), pRows[2]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 12), pRows[3]);
+
+    for (unsigned int y = 0; y < nbRows; ++y)
+        memcpy(pDst2 + y * stride, pixels + 4 * y, nbColumns * sizeof(tBGRAPixel));
+}
+
+
+BLP_TARGET_SSE41 static void blp_dxt1_row_sse41(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    __m128i rows[4];
+
+    for (unsigned int x = 0; x < width; x += 4)
+    {
+        __m128i block = _mm_slli_si128(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pBlocks)), 8);
+
+        blp_dxt_colours_sse41(block, true, rows);
+        blp_dxt_store_sse41(rows, (width - x < 4 ? width - x : 4), nbRows, pDst + x, stride);
+
+        pBlocks += 8;
+    }
+}
+
+
+BLP_TARGET_SSE41 static void blp_dxt3_row_sse41(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    __m128i rows[4];
+
+    for (unsigned int x = 0; x < width; x += 4)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks));
+
+        blp_dxt_colours_sse41(block, false, rows);
+        blp_dxt_merge_alpha_sse41(blp_dxt3_alpha_sse41(block), rows);
+        blp_dxt_store_sse41(rows, (width - x < 4 ? width - x : 4), nbRows, pDst + x, stride);
+
+        pBlocks += 16;
+    }
+}
+
+
+BLP_TARGET_SSE41 static void blp_dxt5_row_sse41(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    __m128i rows[4];
+
+    for (unsigned int x = 0; x < width; x += 4)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks));
+
+        blp_dxt_colours_sse41(block, false, rows);
+        blp_dxt_merge_alpha_sse41(blp_dxt5_alpha_sse41(block), rows);
+        blp_dxt_store_sse41(rows, (width - x < 4 ? width - x : 4), nbRows, pDst + x, stride);
+
+        pBlocks += 16;
+    }
+}
+
+
+// The averages are computed for 8 blocks at once, from the endpoints of each
+// block and the number of pixels using each entry of its palette (counted on
+// the bits of the indices, which are never expanded). The 16-bit lanes of the
+// vectors below hold one block each.
+
+// Number of bits set in each 16-bit lane
+BLP_TARGET_SSE41 static inline __m128i blp_popcount16_sse41(__m128i values)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    const __m128i table      = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+
+    __m128i counts = _mm_add_epi8(_mm_shuffle_epi8(table, _mm_and_si128(values, nibbleMask)),
+                                  _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(values, 4), nibbleMask)));
+
+    // The upper byte of each lane receives the sum of both bytes
+    return _mm_srli_epi16(_mm_mullo_epi16(counts, _mm_set1_epi16(0x0101)), 8);
+}
+
+
+// Sum of one channel over the 16 pixels of each block, rounded and divided
+// by 16 ('c0' and 'c1': the 8-bit values of the endpoints)
+BLP_TARGET_SSE41 static inline __m128i blp_dxt_average_channel_sse41(__m128i c0, __m128i c1, const __m128i* pCounts,
+                                                                     bool isDxt1, __m128i threeColours)
+{
+    // Interpolated values: (2*c0 + c1) / 3 and (c0 + 2*c1) / 3 (x / 3 == (x * 0xAAAB) >> 17)
+    __m128i sum = _mm_add_epi16(c0, c1);
+    __m128i c2  = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(sum, c0), _mm_set1_epi16(int16_t(0xAAAB))), 1);
+    __m128i c3  = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(sum, c1), _mm_set1_epi16(int16_t(0xAAAB))), 1);
+
+    // DXT1 blocks with c0 <= c1: (c0 + c1) / 2 and black
+    if (isDxt1)
+    {
+        c2 = _mm_blendv_epi8(c2, _mm_srli_epi16(sum, 1), threeColours);
+        c3 = _mm_andnot_si128(threeColours, c3);
+    }
+
+    __m128i total = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(pCounts[0], c0), _mm_mullo_epi16(pCounts[1], c1)),
+                                  _mm_add_epi16(_mm_mullo_epi16(pCounts[2], c2), _mm_mullo_epi16(pCounts[3], c3)));
+
+    return _mm_srli_epi16(_mm_add_epi16(total, _mm_set1_epi16(8)), 4);
+}
+
+
+// Computes the average colours of 8 DXT colour blocks (two per register, as
+// stored in the file). The alpha is the one of the colour part: 255, except
+// for the transparent pixels of DXT1 blocks.
+BLP_TARGET_SSE41 static inline void blp_dxt_average_colours_sse41(const __m128i* pColours, bool isDxt1, __m128i* pPixels)
+{
+    // Group the endpoints and the two halves of the indices of each register,
+    // then transpose: one register per field, one 16-bit lane per block
+    const __m128i fields = _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+
+    __m128i v0 = _mm_shuffle_epi8(pColours[0], fields);
+    __m128i v1 = _mm_shuffle_epi8(pColours[1], fields);
+    __m128i v2 = _mm_shuffle_epi8(pColours[2], fields);
+    __m128i v3 = _mm_shuffle_epi8(pColours[3], fields);
+
+    __m128i t0 = _mm_unpacklo_epi32(v0, v1);
+    __m128i t1 = _mm_unpacklo_epi32(v2, v3);
+    __m128i t2 = _mm_unpackhi_epi32(v0, v1);
+    __m128i t3 = _mm_unpackhi_epi32(v2, v3);
+
+    __m128i endpoints0 = _mm_unpacklo_epi64(t0, t1);
+    __m128i endpoints1 = _mm_unpackhi_epi64(t0, t1);
+    __m128i indicesLow  = _mm_unpacklo_epi64(t2, t3);
+    __m128i indicesHigh = _mm_unpackhi_epi64(t2, t3);
+
+    // Both bits of the 16 indices (pixels 0-7 at even positions, 8-15 at odd ones)
+    const __m128i evenBits = _mm_set1_epi16(0x5555);
+
+    __m128i low  = _mm_or_si128(_mm_and_si128(indicesLow, evenBits), _mm_slli_epi16(_mm_and_si128(indicesHigh, evenBits), 1));
+    __m128i high = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(indicesLow, 1), evenBits), _mm_andnot_si128(evenBits, indicesHigh));
+
+    __m128i counts[4];
+    counts[3] = blp_popcount16_sse41(_mm_and_si128(low, high));
+    counts[1] = _mm_sub_epi16(blp_popcount16_sse41(low), counts[3]);
+    counts[2] = _mm_sub_epi16(blp_popcount16_sse41(high), counts[3]);
+    counts[0] = _mm_sub_epi16(_mm_sub_epi16(_mm_set1_epi16(16), counts[1]), _mm_add_epi16(counts[2], counts[3]));
+
+    __m128i threeColours = _mm_cmpeq_epi16(_mm_max_epu16(endpoints0, endpoints1), endpoints1);
+
+    // Expand the 5:6:5 channels to 8 bits, by replicating their upper bits
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+
+    __m128i b0 = _mm_and_si128(endpoints0, mask5);
+    __m128i b1 = _mm_and_si128(endpoints1, mask5);
+    __m128i g0 = _mm_and_si128(_mm_srli_epi16(endpoints0, 5), mask6);
+    __m128i g1 = _mm_and_si128(_mm_srli_epi16(endpoints1, 5), mask6);
+    __m128i r0 = _mm_srli_epi16(endpoints0, 11);
+    __m128i r1 = _mm_srli_epi16(endpoints1, 11);
+
+    b0 = _mm_or_si128(_mm_slli_epi16(b0, 3), _mm_srli_epi16(b0, 2));
+    b1 = _mm_or_si128(_mm_slli_epi16(b1, 3), _mm_srli_epi16(b1, 2));
+    g0 = _mm_or_si128(_mm_slli_epi16(g0, 2), _mm_srli_epi16(g0, 4));
+    g1 = _mm_or_si128(_mm_slli_epi16(g1, 2), _mm_srli_epi16(g1, 4));
+    r0 = _mm_or_si128(_mm_slli_epi16(r0, 3), _mm_srli_epi16(r0, 2));
+    r1 = _mm_or_si128(_mm_slli_epi16(r1, 3), _mm_srli_epi16(r1, 2));
+
+    __m128i blue  = blp_dxt_average_channel_sse41(b0, b1, counts, isDxt1, threeColours);
+    __m128i green = blp_dxt_average_channel_sse41(g0, g1, counts, isDxt1, threeColours);
+    __m128i red   = blp_dxt_average_channel_sse41(r0, r1, counts, isDxt1, threeColours);
+
+    // Only the transparent black pixels of DXT1 blocks aren't opaque
+    __m128i alpha = _mm_set1_epi16(0xFF);
+    if (isDxt1)
+    {
+        __m128i opaque = _mm_sub_epi16(_mm_set1_epi16(16), _mm_and_si128(counts[3], threeColours));
+        alpha = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(opaque, alpha), _mm_set1_epi16(8)), 4);
+    }
+
+    __m128i blueGreen = _mm_or_si128(blue, _mm_slli_epi16(green, 8));
+    __m128i redAlpha  = _mm_or_si128(red, _mm_slli_epi16(alpha, 8));
+
+    pPixels[0] = _mm_unpacklo_epi16(blueGreen, redAlpha);
+    pPixels[1] = _mm_unpackhi_epi16(blueGreen, redAlpha);
+}
+
+
+// Packs the sums of 8 blocks (in the lower 16 bits of each 64-bit lane, two
+// blocks per register) into one 16-bit lane per block
+BLP_TARGET_SSE41 static inline __m128i blp_dxt_pack_sums_sse41(const __m128i* pSums)
+{
+    return _mm_packus_epi32(_mm_packus_epi32(pSums[0], pSums[1]), _mm_packus_epi32(pSums[2], pSums[3]));
+}
+
+
+// Replaces the alpha of the average colours of 8 blocks by 16-bit values
+BLP_TARGET_SSE41 static inline void blp_dxt_merge_average_alpha_sse41(__m128i alpha, __m128i* pPixels)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+    const __m128i zero      = _mm_setzero_si128();
+
+    pPixels[0] = _mm_blendv_epi8(pPixels[0], _mm_slli_epi32(_mm_unpacklo_epi16(alpha, zero), 24), alphaMask);
+    pPixels[1] = _mm_blendv_epi8(pPixels[1], _mm_slli_epi32(_mm_unpackhi_epi16(alpha, zero), 24), alphaMask);
+}
+
+
+BLP_TARGET_SSE41 static void blp_dxt1_average_row_sse41(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    __m128i colours[4];
+    __m128i pixels[2];
+
+    unsigned int i = 0;
+    for (; i + 8 <= nbBlocks; i += 8)
+    {
+        for (unsigned int j = 0; j < 4; ++j)
+            colours[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + 16 * j));
+
+        blp_dxt_average_colours_sse41(colours, true, pixels);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), pixels[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), pixels[1]);
+
+        pBlocks += 64;
+    }
+
+    blp_dxt1_average_row(pBlocks, nbBlocks - i, pDst + i);
+}
+
+
+BLP_TARGET_SSE41 static void blp_dxt3_average_row_sse41(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+    __m128i colours[4];
+    __m128i sums[4];
+    __m128i pixels[2];
+
+    unsigned int i = 0;
+    for (; i + 8 <= nbBlocks; i += 8)
+    {
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + 32 * j));
+            __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + 32 * j + 16));
+
+            // Sum of the 16 4-bit values of both blocks, each expanded to 'v * 17'
+            __m128i alpha   = _mm_unpacklo_epi64(block0, block1);
+            __m128i nibbles = _mm_add_epi8(_mm_and_si128(alpha, nibbleMask), _mm_and_si128(_mm_srli_epi16(alpha, 4), nibbleMask));
+
+            colours[j] = _mm_unpackhi_epi64(block0, block1);
+            sums[j]    = _mm_sad_epu8(nibbles, _mm_setzero_si128());
+        }
+
+        __m128i alpha = _mm_mullo_epi16(blp_dxt_pack_sums_sse41(sums), _mm_set1_epi16(17));
+        alpha = _mm_srli_epi16(_mm_add_epi16(alpha, _mm_set1_epi16(8)), 4);
+
+        blp_dxt_average_colours_sse41(colours, false, pixels);
+        blp_dxt_merge_average_alpha_sse41(alpha, pixels);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), pixels[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), pixels[1]);
+
+        pBlocks += 128;
+    }
+
+    blp_dxt3_average_row(pBlocks, nbBlocks - i, pDst + i);
+}
+
+
+BLP_TARGET_SSE41 static void blp_dxt5_average_row_sse41(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    __m128i colours[4];
+    __m128i sums[4];
+    __m128i pixels[2];
+
+    unsigned int i = 0;
+    for (; i + 8 <= nbBlocks; i += 8)
+    {
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + 32 * j));
+            __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + 32 * j + 16));
+
+            // The interpolated alpha values must be decoded to be summed
+            __m128i sum0 = _mm_sad_epu8(blp_dxt5_alpha_sse41(block0), _mm_setzero_si128());
+            __m128i sum1 = _mm_sad_epu8(blp_dxt5_alpha_sse41(block1), _mm_setzero_si128());
+
+            colours[j] = _mm_unpackhi_epi64(block0, block1);
+            sums[j]    = _mm_add_epi64(_mm_unpacklo_epi64(sum0, sum1), _mm_unpackhi_epi64(sum0, sum1));
+        }
+
+        __m128i alpha = _mm_srli_epi16(_mm_add_epi16(blp_dxt_pack_sums_sse41(sums), _mm_set1_epi16(8)), 4);
+
+        blp_dxt_average_colours_sse41(colours, false, pixels);
+        blp_dxt_merge_average_alpha_sse41(alpha, pixels);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), pixels[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), pixels[1]);
+
+        pBlocks += 128;
+    }
+
+    blp_dxt5_average_row(pBlocks, nbBlocks - i, pDst + i);
+}
+
+
+const tDXTKernels BLP_DXT_KERNELS_SSE41 = {
+    blp_dxt1_row_sse41,
+    blp_dxt3_row_sse41,
+    blp_dxt5_row_sse41,
+    blp_dxt1_average_row_sse41,
+    blp_dxt3_average_row_sse41,
+    blp_dxt5_average_row_sse41,
+};
+
+
+/*************************** Pixel formats (SSE4.1) ***************************/
+
+BLP_TARGET_SSE41 static void blp_to_rgba_sse41(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4 * i), _mm_shuffle_epi8(pixels, swap));
+    }
+
+    blp_to_rgba(pSrc + i, pDst + 4 * i, count - i);
+}
+
+
+// 16 pixels (48 bytes) per iteration
+BLP_TARGET_SSE41 static void blp_to_rgb_sse41(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i rgb0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i)), pack);
+        __m128i rgb1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 4)), pack);
+        __m128i rgb2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 8)), pack);
+        __m128i rgb3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 12)), pack);
+
+        uint8_t* pOut = pDst + 3 * i;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm_or_si128(rgb0, _mm_slli_si128(rgb1, 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 16), _mm_or_si128(_mm_srli_si128(rgb1, 4), _mm_slli_si128(rgb2, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 32), _mm_or_si128(_mm_srli_si128(rgb2, 8), _mm_slli_si128(rgb3, 4)));
+    }
+
+    blp_to_rgb(pSrc + i, pDst + 3 * i, count - i);
+}
+
+
+// Multiplies the colour components of 4 pixels by alpha/255 (rounded like the
+// portable version), and keeps their alpha
+BLP_TARGET_SSE41 static inline __m128i blp_premultiply_sse41(__m128i pixels)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+    const __m128i alphaLow  = _mm_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const __m128i alphaHigh = _mm_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+    const __m128i bias      = _mm_set1_epi16(128);
+    const __m128i zero      = _mm_setzero_si128();
+
+    __m128i low  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), _mm_shuffle_epi8(pixels, alphaLow)), bias);
+    __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), _mm_shuffle_epi8(pixels, alphaHigh)), bias);
+
+    low  = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+    return _mm_blendv_epi8(_mm_packus_epi16(low, high), pixels, alphaMask);
+}
+
+
+BLP_TARGET_SSE41 static void blp_to_bgra_premultiplied_sse41(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4 * i), blp_premultiply_sse41(pixels));
+    }
+
+    blp_to_bgra_premultiplied(pSrc + i, pDst + 4 * i, count - i);
+}
+
+
+BLP_TARGET_SSE41 static void blp_to_rgba_premultiplied_sse41(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4 * i), _mm_shuffle_epi8(blp_premultiply_sse41(pixels), swap));
+    }
+
+    blp_to_rgba_premultiplied(pSrc + i, pDst + 4 * i, count - i);
+}
+
+
+// 16 pixels per iteration
+BLP_TARGET_SSE41 static void blp_to_alpha_sse41(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i alpha0 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i)), 24);
+        __m128i alpha1 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 4)), 24);
+        __m128i alpha2 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 8)), 24);
+        __m128i alpha3 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 12)), 24);
+
+        __m128i alpha = _mm_packus_epi16(_mm_packus_epi32(alpha0, alpha1), _mm_packus_epi32(alpha2, alpha3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), alpha);
+    }
+
+    blp_to_alpha(pSrc + i, pDst + i, count - i);
+}
+
+
+const tPixelFormatKernels BLP_PIXEL_FORMAT_KERNELS_SSE41 = {
+    blp_to_rgba_sse41,
+    blp_to_rgb_sse41,
+    blp_to_bgra_premultiplied_sse41,
+    blp_to_rgba_premultiplied_sse41,
+    blp_to_alpha_sse41,
+};
+
+/************************************ AVX2 ************************************/
+
+// Looks up 8 palette entries
+BLP_TARGET_AVX2 static inline __m256i blp_lookup8_avx2(const int* pTable, const uint8_t* pIndices)
+{
+    __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pIndices)));
+    return _mm256_i32gather_epi32(pTable, indices, 4);
+}
+
+
+// Expands 8 8-bit alpha values into the alpha bytes of 8 pixels
+BLP_TARGET_AVX2 static inline __m256i blp_alpha8_avx2(const uint8_t* pAlpha)
+{
+    __m256i alpha = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pAlpha)));
+    return _mm256_slli_epi32(alpha, 24);
+}
+
+
+BLP_TARGET_AVX2 static void blp_palette_no_alpha_avx2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                      size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m256i opaque = _mm256_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i colours0 = blp_lookup8_avx2(pTable, pIndices + i);
+        __m256i colours1 = blp_lookup8_avx2(pTable, pIndices + i + 8);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_or_si256(colours0, opaque));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i + 8), _mm256_or_si256(colours1, opaque));
+    }
+
+    blp_palette_no_alpha(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX2 static void blp_palette_alpha8_avx2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                    size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m256i colourMask = _mm256_set1_epi32(int(0x00FFFFFF));
+    const uint8_t* pAlpha2 = pAlpha + alphaStart;
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i colours0 = _mm256_and_si256(blp_lookup8_avx2(pTable, pIndices + i), colourMask);
+        __m256i colours1 = _mm256_and_si256(blp_lookup8_avx2(pTable, pIndices + i + 8), colourMask);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_or_si256(colours0, blp_alpha8_avx2(pAlpha2 + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i + 8), _mm256_or_si256(colours1, blp_alpha8_avx2(pAlpha2 + i + 8)));
+    }
+
+    blp_palette_alpha8(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX2 static void blp_palette_palette_alpha_avx2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                           size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i colours0 = blp_lookup8_avx2(pTable, pIndices + i);
+        __m256i colours1 = blp_lookup8_avx2(pTable, pIndices + i + 8);
+
+        // 0xFF - alpha
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_xor_si256(colours0, alphaMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i + 8), _mm256_xor_si256(colours1, alphaMask));
+    }
+
+    blp_palette_palette_alpha(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+// Writes 16 pixels, combining the colours from the palette with 16 alpha bytes
+BLP_TARGET_AVX2 static inline void blp_merge16_avx2(const int* pTable, const uint8_t* pIndices, __m128i alpha, tBGRAPixel* pDst)
+{
+    const __m256i colourMask = _mm256_set1_epi32(int(0x00FFFFFF));
+
+    __m256i colours0 = _mm256_and_si256(blp_lookup8_avx2(pTable, pIndices), colourMask);
+    __m256i colours1 = _mm256_and_si256(blp_lookup8_avx2(pTable, pIndices + 8), colourMask);
+    __m256i alpha0   = _mm256_slli_epi32(_mm256_cvtepu8_epi32(alpha), 24);
+    __m256i alpha1   = _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(alpha, 8)), 24);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst), _mm256_or_si256(colours0, alpha0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 8), _mm256_or_si256(colours1, alpha1));
+}
+
+
+BLP_TARGET_AVX2 static void blp_palette_alpha1_avx2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                    size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    // 32 pixels (4 bytes of the alpha plane) per iteration
+    unsigned int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m128i alpha0 = blp_expand_alpha1_sse41(blp_load_alpha1(pAlpha, alphaStart + i));
+        __m128i alpha1 = blp_expand_alpha1_sse41(blp_load_alpha1(pAlpha, alphaStart + i + 16));
+
+        blp_merge16_avx2(pTable, pIndices + i, alpha0, pDst + i);
+        blp_merge16_avx2(pTable, pIndices + i + 16, alpha1, pDst + i + 16);
+    }
+
+    blp_palette_alpha1_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX2 static void blp_palette_alpha4_avx2(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                    size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    // 32 pixels (16 bytes of the alpha plane) per iteration
+    unsigned int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m128i alpha0 = blp_expand_alpha4_sse2(blp_load_alpha4(pAlpha, alphaStart + i));
+        __m128i alpha1 = blp_expand_alpha4_sse2(blp_load_alpha4(pAlpha, alphaStart + i + 16));
+
+        blp_merge16_avx2(pTable, pIndices + i, alpha0, pDst + i);
+        blp_merge16_avx2(pTable, pIndices + i + 16, alpha1, pDst + i + 16);
+    }
+
+    blp_palette_alpha4_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+const tPaletteKernels BLP_PALETTE_KERNELS_AVX2 = {
+    blp_palette_no_alpha_avx2,
+    blp_palette_alpha1_avx2,
+    blp_palette_alpha4_avx2,
+    blp_palette_alpha8_avx2,
+    blp_palette_palette_alpha_avx2,
+};
+
+
+/********************************* DXT (AVX2) *********************************/
+
+// Same as the SSE4.1 DXT functions, but with two consecutive blocks per
+// register (one per 128-bit lane), so each row of the register holds 8 pixels
+
+// Duplicates a 128-bit constant in both lanes
+BLP_TARGET_AVX2 static inline __m256i blp_dup_avx2(__m128i value)
+{
+    return _mm256_broadcastsi128_si256(value);
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt_palette_avx2(__m256i blocks, bool isDxt1)
+{
+    __m256i endpoints = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(8, 9, 8, 9, 8, 9, -1, -1, 10, 11, 10, 11, 10, 11, -1, -1)));
+
+    __m256i fields  = _mm256_and_si256(endpoints, blp_dup_avx2(_mm_setr_epi16(0x001F, 0x07E0, int16_t(0xF800), 0, 0x001F, 0x07E0, int16_t(0xF800), 0)));
+    __m256i aligned = _mm256_mullo_epi16(fields, blp_dup_avx2(_mm_setr_epi16(2048, 32, 1, 0, 2048, 32, 1, 0)));
+    __m256i colours = _mm256_or_si256(_mm256_srli_epi16(aligned, 8), _mm256_mulhi_epu16(aligned, blp_dup_avx2(_mm_setr_epi16(8, 4, 8, 0, 8, 4, 8, 0))));
+    colours = _mm256_or_si256(colours, blp_dup_avx2(_mm_setr_epi16(0, 0, 0, 0xFF, 0, 0, 0, 0xFF)));
+
+    __m256i swapped = _mm256_shuffle_epi32(colours, _MM_SHUFFLE(1, 0, 3, 2));
+    __m256i sum     = _mm256_add_epi16(colours, swapped);
+    __m256i thirds  = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_add_epi16(sum, colours), _mm256_set1_epi16(int16_t(0xAAAB))), 1);
+
+    if (!isDxt1)
+        return _mm256_packus_epi16(colours, thirds);
+
+    __m256i c0 = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9)));
+    __m256i c1 = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11)));
+    __m256i threeColours = _mm256_cmpeq_epi16(_mm256_max_epu16(c0, c1), c1);
+
+    __m256i halves = _mm256_and_si256(_mm256_srli_epi16(sum, 1), blp_dup_avx2(_mm_setr_epi16(-1, -1, -1, -1, 0, 0, 0, 0)));
+
+    return _mm256_packus_epi16(colours, _mm256_blendv_epi8(thirds, halves, threeColours));
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt_colour_indices_avx2(__m256i blocks)
+{
+    const __m256i shifts = blp_dup_avx2(_mm_setr_epi16(1024, 256, 64, 16, 1024, 256, 64, 16));
+
+    __m256i low  = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(12, -1, 12, -1, 12, -1, 12, -1, 13, -1, 13, -1, 13, -1, 13, -1)));
+    __m256i high = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(14, -1, 14, -1, 14, -1, 14, -1, 15, -1, 15, -1, 15, -1, 15, -1)));
+
+    low  = _mm256_srli_epi16(_mm256_mullo_epi16(low, shifts), 8);
+    high = _mm256_srli_epi16(_mm256_mullo_epi16(high, shifts), 8);
+
+    return _mm256_and_si256(_mm256_packus_epi16(low, high), _mm256_set1_epi8(0x0C));
+}
+
+
+BLP_TARGET_AVX2 static inline void blp_dxt_colours_avx2(__m256i blocks, bool isDxt1, __m256i* pRows)
+{
+    const __m256i channels = blp_dup_avx2(_mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3));
+
+    __m256i palette = blp_dxt_palette_avx2(blocks, isDxt1);
+    __m256i indices = blp_dxt_colour_indices_avx2(blocks);
+
+    pRows[0] = _mm256_shuffle_epi8(palette, _mm256_or_si256(_mm256_shuffle_epi8(indices, blp_dup_avx2(_mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3))), channels));
+    pRows[1] = _mm256_shuffle_epi8(palette, _mm256_or_si256(_mm256_shuffle_epi8(indices, blp_dup_avx2(_mm_setr_epi8(4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7))), channels));
+    pRows[2] = _mm256_shuffle_epi8(palette, _mm256_or_si256(_mm256_shuffle_epi8(indices, blp_dup_avx2(_mm_setr_epi8(8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11))), channels));
+    pRows[3] = _mm256_shuffle_epi8(palette, _mm256_or_si256(_mm256_shuffle_epi8(indices, blp_dup_avx2(_mm_setr_epi8(12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15))), channels));
+}
+
+
+BLP_TARGET_AVX2 static inline void blp_dxt_merge_alpha_avx2(__m256i alpha, __m256i* pRows)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xFF000000));
+
+    pRows[0] = _mm256_blendv_epi8(pRows[0], _mm256_shuffle_epi8(alpha, blp_dup_avx2(_mm_setr_epi8(-1, -1, -1, 0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3))), alphaMask);
+    pRows[1] = _mm256_blendv_epi8(pRows[1], _mm256_shuffle_epi8(alpha, blp_dup_avx2(_mm_setr_epi8(-1, -1, -1, 4, -1, -1, -1, 5, -1, -1, -1, 6, -1, -1, -1, 7))), alphaMask);
+    pRows[2] = _mm256_blendv_epi8(pRows[2], _mm256_shuffle_epi8(alpha, blp_dup_avx2(_mm_setr_epi8(-1, -1, -1, 8, -1, -1, -1, 9, -1, -1, -1, 10, -1, -1, -1, 11))), alphaMask);
+    pRows[3] = _mm256_blendv_epi8(pRows[3], _mm256_shuffle_epi8(alpha, blp_dup_avx2(_mm_setr_epi8(-1, -1, -1, 12, -1, -1, -1, 13, -1, -1, -1, 14, -1, -1, -1, 15))), alphaMask);
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt3_alpha_avx2(__m256i blocks)
+{
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+
+    __m256i low   = _mm256_and_si256(blocks, nibbleMask);
+    __m256i high  = _mm256_and_si256(_mm256_srli_epi16(blocks, 4), nibbleMask);
+    __m256i alpha = _mm256_unpacklo_epi8(low, high);
+
+    return _mm256_or_si256(alpha, _mm256_slli_epi16(alpha, 4));
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt5_alpha_avx2(__m256i blocks)
+{
+    __m256i alpha0 = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1)));
+    __m256i alpha1 = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1)));
+
+    __m256i sum7   = _mm256_add_epi16(_mm256_mullo_epi16(alpha0, blp_dup_avx2(_mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1))),
+                                      _mm256_mullo_epi16(alpha1, blp_dup_avx2(_mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6))));
+    __m256i codes7 = _mm256_mulhi_epu16(sum7, _mm256_set1_epi16(9363));
+
+    __m256i sum5   = _mm256_add_epi16(_mm256_mullo_epi16(alpha0, blp_dup_avx2(_mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0))),
+                                      _mm256_mullo_epi16(alpha1, blp_dup_avx2(_mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0))));
+    __m256i codes5 = _mm256_or_si256(_mm256_mulhi_epu16(sum5, _mm256_set1_epi16(13108)), blp_dup_avx2(_mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0xFF)));
+
+    __m256i use5  = _mm256_cmpeq_epi16(_mm256_max_epu16(alpha0, alpha1), alpha1);
+    __m256i codes = _mm256_blendv_epi8(codes7, codes5, use5);
+    codes = _mm256_packus_epi16(codes, codes);
+
+    const __m256i shifts = blp_dup_avx2(_mm_setr_epi16(256, 32, 4, 128, 16, 2, 64, 8));
+
+    __m256i low  = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 4, 5, 4, 5)));
+    __m256i high = _mm256_shuffle_epi8(blocks, blp_dup_avx2(_mm_setr_epi8(5, 6, 5, 6, 5, 6, 6, 7, 6, 7, 6, 7, 7, 8, 7, 8)));
+
+    low  = _mm256_srli_epi16(_mm256_mullo_epi16(low, shifts), 8);
+    high = _mm256_srli_epi16(_mm256_mullo_epi16(high, shifts), 8);
+
+    __m256i indices = _mm256_and_si256(_mm256_packus_epi16(low, high), _mm256_set1_epi8(0x07));
+
+    return _mm256_shuffle_epi8(codes, indices);
+}
+
+
+// Writes 4 complete rows of 8 pixels
+BLP_TARGET_AVX2 static inline void blp_dxt_store_avx2(const __m256i* pRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    uint8_t* pDst2 = reinterpret_cast<uint8_t*>(pDst);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst2), pRows[0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst2 + stride), pRows[1]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst2 + 2 * stride), pRows[2]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst2 + 3 * stride), pRows[3]);
+}
+
+
+// Only full pairs of blocks are decoded here, the remaining ones (and the
+// blocks of the last, incomplete, row) are left to the SSE4.1 functions
+BLP_TARGET_AVX2 static void blp_dxt1_row_avx2(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    __m256i rows[4];
+    unsigned int x = 0;
+
+    if (nbRows == 4)
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i pair   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks));
+            __m256i blocks = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_slli_si128(pair, 8)), pair, 1);
+
+            blp_dxt_colours_avx2(blocks, true, rows);
+            blp_dxt_store_avx2(rows, pDst + x, stride);
+
+            pBlocks += 16;
+        }
+    }
+
+    if (x < width)
+        blp_dxt1_row_sse41(pBlocks, width - x, nbRows, pDst + x, stride);
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt3_row_avx2(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    __m256i rows[4];
+    unsigned int x = 0;
+
+    if (nbRows == 4)
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            __m256i blocks = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks));
+
+            blp_dxt_colours_avx2(blocks, false, rows);
+            blp_dxt_merge_alpha_avx2(blp_dxt3_alpha_avx2(blocks), rows);
+            blp_dxt_store_avx2(rows, pDst + x, stride);
+
+            pBlocks += 32;
+        }
+    }
+
+    if (x < width)
+        blp_dxt3_row_sse41(pBlocks, width - x, nbRows, pDst + x, stride);
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt5_row_avx2(const uint8_t* pBlocks, unsigned int width, unsigned int nbRows, tBGRAPixel* pDst, ptrdiff_t stride)
+{
+    __m256i rows[4];
+    unsigned int x = 0;
+
+    if (nbRows == 4)
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            __m256i blocks = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks));
+
+            blp_dxt_colours_avx2(blocks, false, rows);
+            blp_dxt_merge_alpha_avx2(blp_dxt5_alpha_avx2(blocks), rows);
+            blp_dxt_store_avx2(rows, pDst + x, stride);
+
+            pBlocks += 32;
+        }
+    }
+
+    if (x < width)
+        blp_dxt5_row_sse41(pBlocks, width - x, nbRows, pDst + x, stride);
+}
+
+
+// Same as the SSE4.1 averages, for 16 blocks: each 128-bit lane computes the
+// averages of 8 of them (see blp_dxt_average_colours_avx2())
+
+BLP_TARGET_AVX2 static inline __m256i blp_popcount16_avx2(__m256i values)
+{
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+    const __m256i table      = blp_dup_avx2(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(values, nibbleMask)),
+                                     _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(values, 4), nibbleMask)));
+
+    return _mm256_srli_epi16(_mm256_mullo_epi16(counts, _mm256_set1_epi16(0x0101)), 8);
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt_average_channel_avx2(__m256i c0, __m256i c1, const __m256i* pCounts,
+                                                                   bool isDxt1, __m256i threeColours)
+{
+    __m256i sum = _mm256_add_epi16(c0, c1);
+    __m256i c2  = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_add_epi16(sum, c0), _mm256_set1_epi16(int16_t(0xAAAB))), 1);
+    __m256i c3  = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_add_epi16(sum, c1), _mm256_set1_epi16(int16_t(0xAAAB))), 1);
+
+    if (isDxt1)
+    {
+        c2 = _mm256_blendv_epi8(c2, _mm256_srli_epi16(sum, 1), threeColours);
+        c3 = _mm256_andnot_si256(threeColours, c3);
+    }
+
+    __m256i total = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(pCounts[0], c0), _mm256_mullo_epi16(pCounts[1], c1)),
+                                     _mm256_add_epi16(_mm256_mullo_epi16(pCounts[2], c2), _mm256_mullo_epi16(pCounts[3], c3)));
+
+    return _mm256_srli_epi16(_mm256_add_epi16(total, _mm256_set1_epi16(8)), 4);
+}
+
+
+// Computes the average colours of 16 DXT colour blocks (two per lane of each
+// register). Each lane of the results holds the pixels of the blocks given to
+// it, in order: the first register gets the 4 first blocks of each lane, the
+// second one the 4 last.
+BLP_TARGET_AVX2 static inline void blp_dxt_average_colours_avx2(const __m256i* pColours, bool isDxt1, __m256i* pPixels)
+{
+    const __m256i fields = blp_dup_avx2(_mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15));
+
+    __m256i v0 = _mm256_shuffle_epi8(pColours[0], fields);
+    __m256i v1 = _mm256_shuffle_epi8(pColours[1], fields);
+    __m256i v2 = _mm256_shuffle_epi8(pColours[2], fields);
+    __m256i v3 = _mm256_shuffle_epi8(pColours[3], fields);
+
+    __m256i t0 = _mm256_unpacklo_epi32(v0, v1);
+    __m256i t1 = _mm256_unpacklo_epi32(v2, v3);
+    __m256i t2 = _mm256_unpackhi_epi32(v0, v1);
+    __m256i t3 = _mm256_unpackhi_epi32(v2, v3);
+
+    __m256i endpoints0 = _mm256_unpacklo_epi64(t0, t1);
+    __m256i endpoints1 = _mm256_unpackhi_epi64(t0, t1);
+    __m256i indicesLow  = _mm256_unpacklo_epi64(t2, t3);
+    __m256i indicesHigh = _mm256_unpackhi_epi64(t2, t3);
+
+    const __m256i evenBits = _mm256_set1_epi16(0x5555);
+
+    __m256i low  = _mm256_or_si256(_mm256_and_si256(indicesLow, evenBits), _mm256_slli_epi16(_mm256_and_si256(indicesHigh, evenBits), 1));
+    __m256i high = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(indicesLow, 1), evenBits), _mm256_andnot_si256(evenBits, indicesHigh));
+
+    __m256i counts[4];
+    counts[3] = blp_popcount16_avx2(_mm256_and_si256(low, high));
+    counts[1] = _mm256_sub_epi16(blp_popcount16_avx2(low), counts[3]);
+    counts[2] = _mm256_sub_epi16(blp_popcount16_avx2(high), counts[3]);
+    counts[0] = _mm256_sub_epi16(_mm256_sub_epi16(_mm256_set1_epi16(16), counts[1]), _mm256_add_epi16(counts[2], counts[3]));
+
+    __m256i threeColours = _mm256_cmpeq_epi16(_mm256_max_epu16(endpoints0, endpoints1), endpoints1);
+
+    const __m256i mask5 = _mm256_set1_epi16(0x1F);
+    const __m256i mask6 = _mm256_set1_epi16(0x3F);
+
+    __m256i b0 = _mm256_and_si256(endpoints0, mask5);
+    __m256i b1 = _mm256_and_si256(endpoints1, mask5);
+    __m256i g0 = _mm256_and_si256(_mm256_srli_epi16(endpoints0, 5), mask6);
+    __m256i g1 = _mm256_and_si256(_mm256_srli_epi16(endpoints1, 5), mask6);
+    __m256i r0 = _mm256_srli_epi16(endpoints0, 11);
+    __m256i r1 = _mm256_srli_epi16(endpoints1, 11);
+
+    b0 = _mm256_or_si256(_mm256_slli_epi16(b0, 3), _mm256_srli_epi16(b0, 2));
+    b1 = _mm256_or_si256(_mm256_slli_epi16(b1, 3), _mm256_srli_epi16(b1, 2));
+    g0 = _mm256_or_si256(_mm256_slli_epi16(g0, 2), _mm256_srli_epi16(g0, 4));
+    g1 = _mm256_or_si256(_mm256_slli_epi16(g1, 2), _mm256_srli_epi16(g1, 4));
+    r0 = _mm256_or_si256(_mm256_slli_epi16(r0, 3), _mm256_srli_epi16(r0, 2));
+    r1 = _mm256_or_si256(_mm256_slli_epi16(r1, 3), _mm256_srli_epi16(r1, 2));
+
+    __m256i blue  = blp_dxt_average_channel_avx2(b0, b1, counts, isDxt1, threeColours);
+    __m256i green = blp_dxt_average_channel_avx2(g0, g1, counts, isDxt1, threeColours);
+    __m256i red   = blp_dxt_average_channel_avx2(r0, r1, counts, isDxt1, threeColours);
+
+    __m256i alpha = _mm256_set1_epi16(0xFF);
+    if (isDxt1)
+    {
+        __m256i opaque = _mm256_sub_epi16(_mm256_set1_epi16(16), _mm256_and_si256(counts[3], threeColours));
+        alpha = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(opaque, alpha), _mm256_set1_epi16(8)), 4);
+    }
+
+    __m256i blueGreen = _mm256_or_si256(blue, _mm256_slli_epi16(green, 8));
+    __m256i redAlpha  = _mm256_or_si256(red, _mm256_slli_epi16(alpha, 8));
+
+    pPixels[0] = _mm256_unpacklo_epi16(blueGreen, redAlpha);
+    pPixels[1] = _mm256_unpackhi_epi16(blueGreen, redAlpha);
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt_pack_sums_avx2(const __m256i* pSums)
+{
+    return _mm256_packus_epi32(_mm256_packus_epi32(pSums[0], pSums[1]), _mm256_packus_epi32(pSums[2], pSums[3]));
+}
+
+
+BLP_TARGET_AVX2 static inline void blp_dxt_merge_average_alpha_avx2(__m256i alpha, __m256i* pPixels)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xFF000000));
+    const __m256i zero      = _mm256_setzero_si256();
+
+    pPixels[0] = _mm256_blendv_epi8(pPixels[0], _mm256_slli_epi32(_mm256_unpacklo_epi16(alpha, zero), 24), alphaMask);
+    pPixels[1] = _mm256_blendv_epi8(pPixels[1], _mm256_slli_epi32(_mm256_unpackhi_epi16(alpha, zero), 24), alphaMask);
+}
+
+
+// Writes the averages of 16 blocks, once put back in order by 'order' (an
+// index of 32-bit element per destination pixel)
+BLP_TARGET_AVX2 static inline void blp_dxt_store_averages_avx2(const __m256i* pPixels, __m256i order, tBGRAPixel* pDst)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst), _mm256_permutevar8x32_epi32(pPixels[0], order));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 8), _mm256_permutevar8x32_epi32(pPixels[1], order));
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt1_average_row_avx2(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    // Each register holds 4 blocks: the lanes get blocks 0-1, 4-5, 8-9, 12-13
+    // and 2-3, 6-7, 10-11, 14-15
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+
+    __m256i colours[4];
+    __m256i pixels[2];
+
+    unsigned int i = 0;
+    for (; i + 16 <= nbBlocks; i += 16)
+    {
+        for (unsigned int j = 0; j < 4; ++j)
+            colours[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks + 32 * j));
+
+        blp_dxt_average_colours_avx2(colours, true, pixels);
+        blp_dxt_store_averages_avx2(pixels, order, pDst + i);
+
+        pBlocks += 128;
+    }
+
+    blp_dxt1_average_row_sse41(pBlocks, nbBlocks - i, pDst + i);
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt3_average_row_avx2(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    // Each register holds 2 blocks: the lanes get the even and the odd blocks
+    const __m256i order      = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+
+    __m256i colours[4];
+    __m256i sums[4];
+    __m256i pixels[2];
+
+    unsigned int i = 0;
+    for (; i + 16 <= nbBlocks; i += 16)
+    {
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            __m256i blocks0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks + 64 * j));
+            __m256i blocks1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks + 64 * j + 32));
+
+            __m256i alpha   = _mm256_unpacklo_epi64(blocks0, blocks1);
+            __m256i nibbles = _mm256_add_epi8(_mm256_and_si256(alpha, nibbleMask), _mm256_and_si256(_mm256_srli_epi16(alpha, 4), nibbleMask));
+
+            colours[j] = _mm256_unpackhi_epi64(blocks0, blocks1);
+            sums[j]    = _mm256_sad_epu8(nibbles, _mm256_setzero_si256());
+        }
+
+        __m256i alpha = _mm256_mullo_epi16(blp_dxt_pack_sums_avx2(sums), _mm256_set1_epi16(17));
+        alpha = _mm256_srli_epi16(_mm256_add_epi16(alpha, _mm256_set1_epi16(8)), 4);
+
+        blp_dxt_average_colours_avx2(colours, false, pixels);
+        blp_dxt_merge_average_alpha_avx2(alpha, pixels);
+        blp_dxt_store_averages_avx2(pixels, order, pDst + i);
+
+        pBlocks += 256;
+    }
+
+    blp_dxt3_average_row_sse41(pBlocks, nbBlocks - i, pDst + i);
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt5_average_row_avx2(const uint8_t* pBlocks, unsigned int nbBlocks, tBGRAPixel* pDst)
+{
+    // Each register holds 2 blocks: the lanes get the even and the odd blocks
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    __m256i colours[4];
+    __m256i sums[4];
+    __m256i pixels[2];
+
+    unsigned int i = 0;
+    for (; i + 16 <= nbBlocks; i += 16)
+    {
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            __m256i blocks0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks + 64 * j));
+            __m256i blocks1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlocks + 64 * j + 32));
+
+            __m256i sum0 = _mm256_sad_epu8(blp_dxt5_alpha_avx2(blocks0), _mm256_setzero_si256());
+            __m256i sum1 = _mm256_sad_epu8(blp_dxt5_alpha_avx2(blocks1), _mm256_setzero_si256());
+
+            colours[j] = _mm256_unpackhi_epi64(blocks0, blocks1);
+            sums[j]    = _mm256_add_epi64(_mm256_unpacklo_epi64(sum0, sum1), _mm256_unpackhi_epi64(sum0, sum1));
+        }
+
+        __m256i alpha = _mm256_srli_epi16(_mm256_add_epi16(blp_dxt_pack_sums_avx2(sums), _mm256_set1_epi16(8)), 4);
+
+        blp_dxt_average_colours_avx2(colours, false, pixels);
+        blp_dxt_merge_average_alpha_avx2(alpha, pixels);
+        blp_dxt_store_averages_avx2(pixels, order, pDst + i);
+
+        pBlocks += 256;
+    }
+
+    blp_dxt5_average_row_sse41(pBlocks, nbBlocks - i, pDst + i);
+}
+
+
+const tDXTKernels BLP_DXT_KERNELS_AVX2 = {
+    blp_dxt1_row_avx2,
+    blp_dxt3_row_avx2,
+    blp_dxt5_row_avx2,
+    blp_dxt1_average_row_avx2,
+    blp_dxt3_average_row_avx2,
+    blp_dxt5_average_row_avx2,
+};
+
+
+/**************************** Pixel formats (AVX2) ****************************/
+
+// Same as the SSE4.1 functions, with 8 pixels per register. The conversion to
+// RGB has no AVX2 implementation.
+
+BLP_TARGET_AVX2 static void blp_to_rgba_avx2(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 4 * i), _mm256_shuffle_epi8(pixels, swap));
+    }
+
+    blp_to_rgba_sse41(pSrc + i, pDst + 4 * i, count - i);
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_premultiply_avx2(__m256i pixels)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xFF000000));
+    const __m256i alphaLow  = _mm256_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1,
+                                               3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const __m256i alphaHigh = _mm256_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1,
+                                               11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+    const __m256i bias      = _mm256_set1_epi16(128);
+    const __m256i zero      = _mm256_setzero_si256();
+
+    __m256i low  = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), _mm256_shuffle_epi8(pixels, alphaLow)), bias);
+    __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), _mm256_shuffle_epi8(pixels, alphaHigh)), bias);
+
+    low  = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+    high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+    return _mm256_blendv_epi8(_mm256_packus_epi16(low, high), pixels, alphaMask);
+}
+
+
+BLP_TARGET_AVX2 static void blp_to_bgra_premultiplied_avx2(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 4 * i), blp_premultiply_avx2(pixels));
+    }
+
+    blp_to_bgra_premultiplied_sse41(pSrc + i, pDst + 4 * i, count - i);
+}
+
+
+BLP_TARGET_AVX2 static void blp_to_rgba_premultiplied_avx2(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 4 * i), _mm256_shuffle_epi8(blp_premultiply_avx2(pixels), swap));
+    }
+
+    blp_to_rgba_premultiplied_sse41(pSrc + i, pDst + 4 * i, count - i);
+}
+
+
+// 32 pixels per iteration. The packing works inside each lane, so the groups
+// of 4 alpha values must be put back in order.
+BLP_TARGET_AVX2 static void blp_to_alpha_avx2(const tBGRAPixel* pSrc, uint8_t* pDst, unsigned int count)
+{
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    unsigned int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i alpha0 = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i)), 24);
+        __m256i alpha1 = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 8)), 24);
+        __m256i alpha2 = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 16)), 24);
+        __m256i alpha3 = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 24)), 24);
+
+        __m256i alpha = _mm256_packus_epi16(_mm256_packus_epi32(alpha0, alpha1), _mm256_packus_epi32(alpha2, alpha3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm256_permutevar8x32_epi32(alpha, order));
+    }
+
+    blp_to_alpha_sse41(pSrc + i, pDst + i, count - i);
+}
+
+
+const tPixelFormatKernels BLP_PIXEL_FORMAT_KERNELS_AVX2 = {
+    blp_to_rgba_avx2,
+    blp_to_rgb_sse41,
+    blp_to_bgra_premultiplied_avx2,
+    blp_to_rgba_premultiplied_avx2,
+    blp_to_alpha_avx2,
+};
+
+/*********************************** AVX-512 **********************************/
+
+// Only the paletted images have AVX-512 implementations (AVX-512F only: a 16-way
+// gather and masked blends). The DXT images use the AVX2 functions.
+
+// The AVX-512 intrinsics of GCC 12 trigger spurious warnings about the
+// (deliberately) undefined registers they start from
+#if defined(__GNUC__) && !defined(__clang__)
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Looks up 16 palette entries
+BLP_TARGET_AVX512 static inline __m512i blp_lookup16_avx512(const int* pTable, const uint8_t* pIndices)
+{
+    __m512i indices = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pIndices)));
+    return _mm512_i32gather_epi32(indices, pTable, 4);
+}
+
+
+// Moves 16 alpha bytes into the alpha bytes of 16 pixels
+BLP_TARGET_AVX512 static inline __m512i blp_spread_alpha_avx512(__m128i alpha)
+{
+    return _mm512_slli_epi32(_mm512_cvtepu8_epi32(alpha), 24);
+}
+
+
+BLP_TARGET_AVX512 static void blp_palette_no_alpha_avx512(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                          size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m512i opaque = _mm512_set1_epi32(int(0xFF000000));
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+        _mm512_storeu_si512(pDst + i, _mm512_or_si512(blp_lookup16_avx512(pTable, pIndices + i), opaque));
+
+    blp_palette_no_alpha_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX512 static void blp_palette_alpha8_avx512(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                        size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m512i colourMask = _mm512_set1_epi32(int(0x00FFFFFF));
+    const uint8_t* pAlpha2 = pAlpha + alphaStart;
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i colours = _mm512_and_si512(blp_lookup16_avx512(pTable, pIndices + i), colourMask);
+        __m512i alpha   = blp_spread_alpha_avx512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pAlpha2 + i)));
+
+        _mm512_storeu_si512(pDst + i, _mm512_or_si512(colours, alpha));
+    }
+
+    blp_palette_alpha8_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX512 static void blp_palette_palette_alpha_avx512(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                               size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m512i alphaMask = _mm512_set1_epi32(int(0xFF000000));
+
+    // 0xFF - alpha
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+        _mm512_storeu_si512(pDst + i, _mm512_xor_si512(blp_lookup16_avx512(pTable, pIndices + i), alphaMask));
+
+    blp_palette_palette_alpha_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX512 static void blp_palette_alpha1_avx512(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                        size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m512i colourMask = _mm512_set1_epi32(int(0x00FFFFFF));
+    const __m512i alphaMask  = _mm512_set1_epi32(int(0xFF000000));
+
+    // The 16 bits of the alpha plane are directly used as a mask
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i colours = _mm512_and_si512(blp_lookup16_avx512(pTable, pIndices + i), colourMask);
+        __mmask16 opaque = __mmask16(blp_load_alpha1(pAlpha, alphaStart + i));
+
+        _mm512_storeu_si512(pDst + i, _mm512_mask_or_epi32(colours, opaque, colours, alphaMask));
+    }
+
+    blp_palette_alpha1_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+BLP_TARGET_AVX512 static void blp_palette_alpha4_avx512(const tBGRAPixel* pPalette, const uint8_t* pIndices, const uint8_t* pAlpha,
+                                                        size_t alphaStart, tBGRAPixel* pDst, unsigned int count)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+    const __m512i colourMask = _mm512_set1_epi32(int(0x00FFFFFF));
+
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i colours = _mm512_and_si512(blp_lookup16_avx512(pTable, pIndices + i), colourMask);
+        __m512i alpha   = blp_spread_alpha_avx512(blp_expand_alpha4_sse2(blp_load_alpha4(pAlpha, alphaStart + i)));
+
+        _mm512_storeu_si512(pDst + i, _mm512_or_si512(colours, alpha));
+    }
+
+    blp_palette_alpha4_sse41(pPalette, pIndices + i, pAlpha, alphaStart + i, pDst + i, count - i);
+}
+
+
+const tPaletteKernels BLP_PALETTE_KERNELS_AVX512 = {
+    blp_palette_no_alpha_avx512,
+    blp_palette_alpha1_avx512,
+    blp_palette_alpha4_avx512,
+    blp_palette_alpha8_avx512,
+    blp_palette_palette_alpha_avx512,
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#   pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,251 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_threads.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#   include <pthread.h>
+#endif
+
+
+#ifndef _WIN32
+
+// The thread pool. Only one job is executed at a time: 'jobMutex' is held by
+// the thread that submitted it, and by blp_setNbThreads() while the workers
+// are replaced. The rest of the state is protected by 'mutex'.
+struct tThreadPool
+{
+    pthread_mutex_t jobMutex;
+    pthread_mutex_t mutex;
+    pthread_cond_t  wakeUp;     // Signaled when a job is submitted (or the workers must stop)
+    pthread_cond_t  done;       // Signaled when the last range of a job is processed
+
+    pthread_t*      pWorkers;
+    unsigned int    nbWorkers;
+    size_t          minPixels;
+    bool            stop;
+
+    // The current job
+    unsigned int    generation; // Incremented for each job
+    tRowsFunction   function;
+    void*           pUserData;
+    unsigned int    nbRows;
+    unsigned int    rangeSize;
+    unsigned int    nbRanges;
+    unsigned int    nextRange;
+    unsigned int    nbRemaining;
+};
+
+
+static tThreadPool pool = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    0, 0, 0, false,
+    0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+
+// Processes the remaining ranges of the current job. Must be called with
+// 'pool.mutex' locked.
+static void blp_processRanges(unsigned int thread)
+{
+    while (pool.nextRange < pool.nbRanges)
+    {
+        unsigned int first = pool.nextRange * pool.rangeSize;
+        unsigned int count = pool.rangeSize;
+        if (first + count > pool.nbRows)
+            count = pool.nbRows - first;
+
+        ++pool.nextRange;
+
+        pthread_mutex_unlock(&pool.mutex);
+        pool.function(pool.pUserData, thread, first, count);
+        pthread_mutex_lock(&pool.mutex);
+
+        --pool.nbRemaining;
+        if (pool.nbRemaining == 0)
+            pthread_cond_broadcast(&pool.done);
+    }
+}
+
+
+// 'pArg' is the index of the thread (the calling thread of a job is 0)
+static void* blp_worker(void* pArg)
+{
+    unsigned int thread = unsigned(reinterpret_cast<size_t>(pArg));
+
+    pthread_mutex_lock(&pool.mutex);
+
+    unsigned int generation = pool.generation;
+
+    while (true)
+    {
+        while (!pool.stop && (pool.generation == generation))
+            pthread_cond_wait(&pool.wakeUp, &pool.mutex);
+
+        if (pool.stop)
+            break;
+
+        generation = pool.generation;
+        blp_processRanges(thread);
+    }
+
+    pthread_mutex_unlock(&pool.mutex);
+
+    return 0;
+}
+
+
+void blp_setNbThreads(unsigned int nbThreads, size_t minPixels)
+{
+    pthread_mutex_lock(&pool.jobMutex);
+
+    // Stop the current workers
+    if (pool.nbWorkers > 0)
+    {
+        pthread_mutex_lock(&pool.mutex);
+        pool.stop = true;
+        pthread_cond_broadcast(&pool.wakeUp);
+        pthread_mutex_unlock(&pool.mutex);
+
+        for (unsigned int i = 0; i < pool.nbWorkers; ++i)
+            pthread_join(pool.pWorkers[i], 0);
+
+        blp_free(pool.pWorkers);
+        pool.pWorkers = 0;
+        pool.nbWorkers = 0;
+        pool.stop = false;
+    }
+
+    pool.minPixels = minPixels;
+
+    // Start the new ones (the calling thread of a job is the last one)
+    if (nbThreads > 1)
+    {
+        pool.pWorkers = blp_allocateArray<pthread_t>(nbThreads - 1);
+
+        for (unsigned int i = 0; pool.pWorkers && (i < nbThreads - 1); ++i)
+        {
+            if (pthread_create(&pool.pWorkers[pool.nbWorkers], 0, blp_worker, reinterpret_cast<void*>(size_t(pool.nbWorkers + 1))) == 0)
+                ++pool.nbWorkers;
+        }
+    }
+
+    pthread_mutex_unlock(&pool.jobMutex);
+}
+
+
+unsigned int blp_nbPoolThreads()
+{
+    return pool.nbWorkers + 1;
+}
+
+
+size_t blp_poolMinPixels()
+{
+    return pool.minPixels;
+}
+
+
+// Executes a job with the workers, in ranges of 'rangeSize' rows. Must be
+// called with 'pool.jobMutex' locked (and releases it).
+static void blp_runJob(tRowsFunction function, void* pUserData, unsigned int nbRows, unsigned int rangeSize)
+{
+    pthread_mutex_lock(&pool.mutex);
+
+    pool.function    = function;
+    pool.pUserData   = pUserData;
+    pool.nbRows      = nbRows;
+    pool.rangeSize   = rangeSize;
+    pool.nbRanges    = (nbRows + rangeSize - 1) / rangeSize;
+    pool.nextRange   = 0;
+    pool.nbRemaining = pool.nbRanges;
+    ++pool.generation;
+
+    pthread_cond_broadcast(&pool.wakeUp);
+
+    blp_processRanges(0);
+
+    while (pool.nbRemaining > 0)
+        pthread_cond_wait(&pool.done, &pool.mutex);
+
+    pthread_mutex_unlock(&pool.mutex);
+    pthread_mutex_unlock(&pool.jobMutex);
+}
+
+
+void blp_parallelRows(tRowsFunction function, void* pUserData, unsigned int nbRows, size_t nbPixels)
+{
+    if ((nbRows < 2) || (pthread_mutex_trylock(&pool.jobMutex) != 0))
+    {
+        function(pUserData, 0, 0, nbRows);
+        return;
+    }
+
+    if ((pool.nbWorkers == 0) || (nbPixels < pool.minPixels))
+    {
+        pthread_mutex_unlock(&pool.jobMutex);
+        function(pUserData, 0, 0, nbRows);
+        return;
+    }
+
+    // A few ranges per thread, so a slow thread doesn't delay the whole job
+    unsigned int nbRanges = std::min(nbRows, (pool.nbWorkers + 1) * 4);
+
+    blp_runJob(function, pUserData, nbRows, (nbRows + nbRanges - 1) / nbRanges);
+}
+
+
+void blp_parallelItems(tRowsFunction function, void* pUserData, unsigned int nbItems)
+{
+    if ((nbItems < 2) || (pthread_mutex_trylock(&pool.jobMutex) != 0))
+    {
+        function(pUserData, 0, 0, nbItems);
+        return;
+    }
+
+    if (pool.nbWorkers == 0)
+    {
+        pthread_mutex_unlock(&pool.jobMutex);
+        function(pUserData, 0, 0, nbItems);
+        return;
+    }
+
+    blp_runJob(function, pUserData, nbItems, 1);
+}
+
+#else
+
+// No thread pool on Windows: everything is done by the calling thread
+
+void blp_setNbThreads(unsigned int nbThreads, size_t minPixels)
+{
+}
+
+
+unsigned int blp_nbPoolThreads()
+{
+    return 1;
+}
+
+
+size_t blp_poolMinPixels()
+{
+    return 0;
+}
+
+
+void blp_parallelRows(tRowsFunction function, void* pUserData, unsigned int nbRows, size_t nbPixels)
+{
+    function(pUserData, 0, 0, nbRows);
+}
+
+
+void blp_parallelItems(tRowsFunction function, void* pUserData, unsigned int nbItems)
+{
+    function(pUserData, 0, 0, nbItems);
+}
+
+#endif
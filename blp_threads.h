@@ -0,0 +1,33 @@
+#ifndef _BLP_THREADS_H_
+#define _BLP_THREADS_H_
+
+#include <stddef.h>
+
+
+// Signature of the functions processing the rows [first, first + count) of a job.
+// 'thread' identifies the thread doing it, from 0 (the calling thread) to
+// blp_nbPoolThreads() - 1.
+typedef void (*tRowsFunction)(void* pUserData, unsigned int thread, unsigned int first, unsigned int count);
+
+
+// Number of threads that can take part in a job (the calling thread included)
+unsigned int blp_nbPoolThreads();
+
+// Minimum number of pixels of a job to use the pool (see blp_setNbThreads())
+size_t blp_poolMinPixels();
+
+
+// Processes 'nbRows' rows, split in ranges distributed between the threads of
+// the pool (see blp_setNbThreads()). The calling thread takes part in the job,
+// and the function only returns once all the rows are processed.
+//
+// The rows are processed by the calling thread alone when the pool is disabled,
+// when the job is smaller than the threshold ('nbPixels' is the size of the
+// whole job), or when the pool is already busy with another job.
+void blp_parallelRows(tRowsFunction function, void* pUserData, unsigned int nbRows, size_t nbPixels);
+
+// Same as blp_parallelRows(), but for 'nbItems' independent items of varying
+// cost (files, ...): they are distributed one by one, whatever their number.
+void blp_parallelItems(tRowsFunction function, void* pUserData, unsigned int nbItems);
+
+#endif
@@ -1,7 +1,6 @@
 #include "blp.h"
 #include <SimpleOpt.h>
 #include <FreeImage.h>
-#include <memory.h>
 #include <iostream>
 #include <string>
 
@@ -158,25 +157,19 @@ int main(int argc, char** argv)
 
         if (!bInfos)
         {
-            tBGRAPixel* pData = blp_convert(pFile, blpInfos, mipLevel);
-            if (pData)
+            unsigned int width = blp_width(blpInfos, mipLevel);
+            unsigned int height = blp_height(blpInfos, mipLevel);
+
+            FIBITMAP* pImage = FreeImage_Allocate(width, height, 32, 0x000000FF, 0x0000FF00, 0x00FF0000);
+            if (pImage)
             {
-                unsigned int width = blp_width(blpInfos, mipLevel);
-                unsigned int height = blp_height(blpInfos, mipLevel);
+                // FreeImage stores the rows bottom-up: the pixels are decoded
+                // directly in the bitmap, from its last scanline upwards
+                tBGRAPixel* pDst = reinterpret_cast<tBGRAPixel*>(FreeImage_GetScanLine(pImage, height - 1));
+                ptrdiff_t dstStride = -ptrdiff_t(FreeImage_GetPitch(pImage));
 
-                FIBITMAP* pImage = FreeImage_Allocate(width, height, 32, 0x000000FF, 0x0000FF00, 0x00FF0000);
-                if (pImage)
+                if (blp_convertInto(pFile, blpInfos, mipLevel, pDst, dstStride))
                 {
-                    tBGRAPixel* pSrc = pData + (height - 1) * width;
-
-                    for (unsigned int y = 0; y < height; ++y)
-                    {
-                        BYTE* pLine = FreeImage_GetScanLine(pImage, y);
-                        memcpy(pLine, pSrc, width * sizeof(tBGRAPixel));
-
-                        pSrc -= width;
-                    }
-
                     if (FreeImage_Save((strFormat == "tga" ? FIF_TARGA : FIF_PNG), pImage, (strOutputFolder + strOutFileName).c_str(), 0))
                     {
                         cerr << strInFileName << ": OK" << endl;
@@ -186,19 +179,17 @@ int main(int argc, char** argv)
                     {
                         cerr << strInFileName << ": Failed to save the image" << endl;
                     }
-
-                    FreeImage_Unload(pImage);
                 }
                 else
                 {
-                    cerr << strInFileName << ": Failed to allocate memory" << endl;
+                    cerr << strInFileName << ": Unsupported format" << endl;
                 }
 
-                delete[] pData;
+                FreeImage_Unload(pImage);
             }
             else
             {
-                cerr << strInFileName << ": Unsupported format" << endl;
+                cerr << strInFileName << ": Failed to allocate memory" << endl;
             }
         }
         else
@@ -0,0 +1,127 @@
+// Checks that BLP files with truncated mip levels, huge dimensions or
+// inconsistent headers are rejected, instead of being read past the end of
+// their data
+
+#include "blp.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+static int nbFailures = 0;
+
+#define CHECK(condition)                                                    \
+    if (!(condition))                                                       \
+    {                                                                       \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        ++nbFailures;                                                       \
+    }
+
+
+// Returns a BLP2 file with one mip level of 'mipSize' bytes
+static std::vector<uint8_t> createBLP2(uint8_t encoding, uint8_t alphaDepth, uint32_t width, uint32_t height, uint32_t mipSize)
+{
+    const uint32_t headerSize = 148 + 256 * 4;
+
+    std::vector<uint8_t> data(headerSize + mipSize, 0);
+
+    uint32_t type = 1;
+
+    memcpy(&data[0], "BLP2", 4);
+    memcpy(&data[4], &type, 4);
+    data[8] = encoding;
+    data[9] = alphaDepth;
+    memcpy(&data[12], &width, 4);
+    memcpy(&data[16], &height, 4);
+    memcpy(&data[20], &headerSize, 4);     // offsets[0]
+    memcpy(&data[84], &mipSize, 4);        // lengths[0]
+
+    return data;
+}
+
+
+static void checkRejected(const std::vector<uint8_t>& data)
+{
+    tBLPInfos blpInfos = blp_processMemory(&data[0], data.size());
+    CHECK(blpInfos != 0);
+    if (!blpInfos)
+        return;
+
+    unsigned int height = blp_height(blpInfos);
+
+    tBGRAPixel pixel;
+    CHECK(!blp_convertMemoryRegion(&data[0], data.size(), blpInfos, 0, 0, height - 1, 1, 1, BLP_PIXEL_FORMAT_BGRA, &pixel));
+    CHECK(blp_viewMemory(&data[0], data.size(), blpInfos, 0) == 0);
+
+    blp_release(blpInfos);
+}
+
+
+int main()
+{
+    // Valid file, for reference
+    std::vector<uint8_t> data = createBLP2(BLP_ENCODING_UNCOMPRESSED_RAW_BGRA, 8, 4, 4, 64);
+    tBLPInfos blpInfos = blp_processMemory(&data[0], data.size());
+    CHECK(blpInfos != 0);
+    CHECK(blp_viewMemory(&data[0], data.size(), blpInfos, 0) != 0);
+    blp_release(blpInfos);
+
+    // Truncated mip levels
+    checkRejected(createBLP2(BLP_ENCODING_UNCOMPRESSED_RAW_BGRA, 8, 4, 4, 63));
+    checkRejected(createBLP2(BLP_ENCODING_UNCOMPRESSED, 0, 16, 16, 255));
+    checkRejected(createBLP2(BLP_ENCODING_DXT, 0, 16, 16, 127));
+
+    // Length past the end of the file: the mip level is cut, and still holds
+    // the whole image
+    data = createBLP2(BLP_ENCODING_UNCOMPRESSED_RAW_BGRA, 8, 4, 4, 64);
+    uint32_t length = 80;
+    memcpy(&data[84], &length, 4);
+    blpInfos = blp_processMemory(&data[0], data.size());
+    CHECK(blpInfos != 0);
+    if (blpInfos)
+    {
+        tBGRAPixel* pPixels = blp_convertMemory(&data[0], data.size(), blpInfos, 0);
+        CHECK(pPixels != 0);
+        CHECK(blp_viewMemory(&data[0], data.size(), blpInfos, 0) != 0);
+        blp_free(pPixels);
+        blp_release(blpInfos);
+    }
+
+    // Huge dimensions, whose size wraps on 32 bits
+    checkRejected(createBLP2(BLP_ENCODING_UNCOMPRESSED_RAW_BGRA, 8, 32768, 32768, 16));
+    checkRejected(createBLP2(BLP_ENCODING_UNCOMPRESSED, 0, 65536, 65536, 16));
+    checkRejected(createBLP2(BLP_ENCODING_DXT, 0, 0x40000000, 0x40000, 16));
+
+    // BLP2 file with JPEG data: unsupported (there are no JPEG tables, the
+    // palette must not be taken for them)
+    data = createBLP2(BLP_ENCODING_UNCOMPRESSED, 0, 4, 4, 16);
+    data[4] = 0;    // type
+    memset(&data[148], 0x11, 256 * 4);
+    checkRejected(data);
+
+    // No mip levels (empty table of offsets)
+    data = createBLP2(BLP_ENCODING_UNCOMPRESSED_RAW_BGRA, 8, 4, 4, 64);
+    memset(&data[20], 0, 16 * 4);
+    CHECK(blp_processMemory(&data[0], data.size()) == 0);
+
+    tBLPSource source;
+    memset(&source, 0, sizeof(source));
+    source.pData    = &data[0];
+    source.dataSize = data.size();
+    CHECK(blp_processSource(&source) == 0);
+
+    // Truncated header
+    data = createBLP2(BLP_ENCODING_UNCOMPRESSED_RAW_BGRA, 8, 4, 4, 64);
+    data.resize(100);
+    blpInfos = blp_processMemory(&data[0], data.size());
+    if (blpInfos)
+    {
+        CHECK(blp_viewMemory(&data[0], data.size(), blpInfos, 0) == 0);
+        blp_release(blpInfos);
+    }
+
+    if (nbFailures > 0)
+        printf("%d check(s) failed\n", nbFailures);
+
+    return (nbFailures > 0 ? 1 : 0);
+}
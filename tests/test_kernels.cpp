@@ -0,0 +1,307 @@
+// Checks that the SIMD kernels supported by the CPU (down to the level forced by
+// the BLP_KERNELS environment variable) produce exactly the same pixels as the
+// scalar ones, on random rows of any length
+
+#include "blp.h"
+#include "blp_kernels.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+static int nbFailures = 0;
+
+// Deterministic pseudo-random generator, so failures can be reproduced
+static uint32_t randomState = 12345;
+
+static uint8_t randomByte()
+{
+    randomState = randomState * 1103515245 + 12345;
+    return uint8_t(randomState >> 16);
+}
+
+
+static void fillRandom(void* pBuffer, size_t size)
+{
+    uint8_t* pBytes = (uint8_t*) pBuffer;
+    for (size_t i = 0; i < size; ++i)
+        pBytes[i] = randomByte();
+}
+
+
+// Compare two buffers, and report the first difference
+static bool same(const char* strName, const char* strFunction, unsigned int param1,
+                 unsigned int param2, const void* pExpected, const void* pActual, size_t size)
+{
+    const uint8_t* pA = (const uint8_t*) pExpected;
+    const uint8_t* pB = (const uint8_t*) pActual;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (pA[i] != pB[i])
+        {
+            printf("%s.%s(%u, %u): byte %u is 0x%02X instead of 0x%02X\n", strName, strFunction,
+                   param1, param2, (unsigned int) i, pB[i], pA[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/************************************** PALETTE ***************************************/
+
+static void testPalette(const char* strName, const tPaletteKernels* pKernels)
+{
+    const tPaletteRowFunction* pReference = &BLP_PALETTE_KERNELS_SCALAR.noAlpha;
+    const tPaletteRowFunction* pFunctions = &pKernels->noAlpha;
+    const char* FUNCTIONS[] = { "noAlpha", "alpha1", "alpha4", "alpha8", "paletteAlpha" };
+
+    const unsigned int MAX_COUNT = 140;
+    const unsigned int MAX_ALPHA_START = 17;
+
+    tBGRAPixel palette[256];
+    uint8_t indices[MAX_COUNT];
+    uint8_t alpha[MAX_ALPHA_START + MAX_COUNT];
+
+    // One more pixel than needed, to detect writes past the end of the row
+    tBGRAPixel expected[MAX_COUNT + 1];
+    tBGRAPixel actual[MAX_COUNT + 1];
+
+    for (unsigned int f = 0; f < 5; ++f)
+    {
+        for (unsigned int count = 0; count <= MAX_COUNT; ++count)
+        {
+            for (unsigned int alphaStart = 0; alphaStart <= MAX_ALPHA_START; ++alphaStart)
+            {
+                fillRandom(palette, sizeof(palette));
+                fillRandom(indices, sizeof(indices));
+                fillRandom(alpha, sizeof(alpha));
+
+                memset(expected, 0xCD, sizeof(expected));
+                memset(actual, 0xCD, sizeof(actual));
+
+                pReference[f](palette, indices, alpha, alphaStart, expected, count);
+                pFunctions[f](palette, indices, alpha, alphaStart, actual, count);
+
+                if (!same(strName, FUNCTIONS[f], count, alphaStart, expected, actual, sizeof(expected)))
+                {
+                    ++nbFailures;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+/**************************************** DXT *****************************************/
+
+// Random blocks, but also blocks with equal or ordered endpoints, which select
+// the other interpolation modes of DXT1 and DXT5
+static void fillRandomBlocks(uint8_t* pBlocks, unsigned int nbBlocks, unsigned int blockSize)
+{
+    fillRandom(pBlocks, nbBlocks * blockSize);
+
+    for (unsigned int i = 0; i < nbBlocks; ++i)
+    {
+        uint8_t* pBlock = pBlocks + i * blockSize;
+        uint8_t* pColors = pBlock + blockSize - 8;
+
+        switch (randomByte() % 4)
+        {
+            case 0:     // c0 == c1, a0 == a1
+                pColors[2] = pColors[0];
+                pColors[3] = pColors[1];
+                pBlock[1] = pBlock[0];
+                break;
+
+            case 1:     // c0 < c1, a0 < a1
+                pColors[1] = 0x00;
+                pColors[3] = 0xFF;
+                pBlock[0] = 0x10;
+                pBlock[1] = 0xF0;
+                break;
+
+            case 2:     // c0 > c1, a0 > a1
+                pColors[1] = 0xFF;
+                pColors[3] = 0x00;
+                pBlock[0] = 0xF0;
+                pBlock[1] = 0x10;
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+
+static void testDXT(const char* strName, const tDXTKernels* pKernels)
+{
+    const tDXTRowFunction REFERENCE_ROWS[] = {
+        BLP_DXT_KERNELS_SCALAR.dxt1, BLP_DXT_KERNELS_SCALAR.dxt3, BLP_DXT_KERNELS_SCALAR.dxt5
+    };
+    const tDXTRowFunction ROWS[] = { pKernels->dxt1, pKernels->dxt3, pKernels->dxt5 };
+
+    const tDXTAverageFunction REFERENCE_AVERAGES[] = {
+        BLP_DXT_KERNELS_SCALAR.dxt1Average, BLP_DXT_KERNELS_SCALAR.dxt3Average,
+        BLP_DXT_KERNELS_SCALAR.dxt5Average
+    };
+    const tDXTAverageFunction AVERAGES[] = { pKernels->dxt1Average, pKernels->dxt3Average, pKernels->dxt5Average };
+
+    const char* ROW_NAMES[] = { "dxt1", "dxt3", "dxt5" };
+    const char* AVERAGE_NAMES[] = { "dxt1Average", "dxt3Average", "dxt5Average" };
+    const unsigned int BLOCK_SIZES[] = { 8, 16, 16 };
+
+    const unsigned int MAX_WIDTH = 70;
+    const unsigned int MAX_BLOCKS = 70;
+    const unsigned int PADDING = 3;
+
+    // The blocks are read at every offset from the start of a 16-bytes boundary
+    std::vector<uint8_t> blocks(16 + MAX_BLOCKS * 16);
+
+    std::vector<tBGRAPixel> expected(4 * (MAX_WIDTH + PADDING));
+    std::vector<tBGRAPixel> actual(expected.size());
+
+    for (unsigned int e = 0; e < 3; ++e)
+    {
+        const size_t rowSize = 4 * (MAX_WIDTH + PADDING) * sizeof(tBGRAPixel);
+
+        // Rows: only the requested columns and rows must be written
+        for (unsigned int width = 1; width <= MAX_WIDTH; ++width)
+        {
+            for (unsigned int nbRows = 1; nbRows <= 4; ++nbRows)
+            {
+                unsigned int offset = randomByte() % 16;
+                ptrdiff_t stride = (width + randomByte() % (PADDING + 1)) * sizeof(tBGRAPixel);
+
+                fillRandomBlocks(&blocks[offset], (width + 3) / 4, BLOCK_SIZES[e]);
+
+                memset(&expected[0], 0xCD, rowSize);
+                memset(&actual[0], 0xCD, rowSize);
+
+                REFERENCE_ROWS[e](&blocks[offset], width, nbRows, &expected[0], stride);
+                ROWS[e](&blocks[offset], width, nbRows, &actual[0], stride);
+
+                if (!same(strName, ROW_NAMES[e], width, nbRows, &expected[0], &actual[0], rowSize))
+                {
+                    ++nbFailures;
+                    break;
+                }
+            }
+        }
+
+        // Averages: one pixel per block, nothing past the last one
+        for (unsigned int nbBlocks = 0; nbBlocks <= MAX_BLOCKS; ++nbBlocks)
+        {
+            for (unsigned int offset = 0; offset < 16; offset += 3)
+            {
+                fillRandomBlocks(&blocks[offset], nbBlocks, BLOCK_SIZES[e]);
+
+                memset(&expected[0], 0xCD, (MAX_BLOCKS + 1) * sizeof(tBGRAPixel));
+                memset(&actual[0], 0xCD, (MAX_BLOCKS + 1) * sizeof(tBGRAPixel));
+
+                REFERENCE_AVERAGES[e](&blocks[offset], nbBlocks, &expected[0]);
+                AVERAGES[e](&blocks[offset], nbBlocks, &actual[0]);
+
+                if (!same(strName, AVERAGE_NAMES[e], nbBlocks, offset, &expected[0], &actual[0],
+                          (MAX_BLOCKS + 1) * sizeof(tBGRAPixel)))
+                {
+                    ++nbFailures;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+/************************************ PIXEL FORMATS ***********************************/
+
+static void testPixelFormats(const char* strName, const tPixelFormatKernels* pKernels)
+{
+    const tPixelRowFunction* pReference = &BLP_PIXEL_FORMAT_KERNELS_SCALAR.rgba;
+    const tPixelRowFunction* pFunctions = &pKernels->rgba;
+    const char* FUNCTIONS[] = { "rgba", "rgb", "bgraPremultiplied", "rgbaPremultiplied", "alpha" };
+
+    const unsigned int MAX_COUNT = 140;
+
+    // The source pixels are read at every offset from the start of a 16-bytes
+    // boundary, and one more pixel than needed is kept to detect writes past
+    // the end of the row
+    std::vector<tBGRAPixel> src(MAX_COUNT + 4);
+    std::vector<uint8_t> expected((MAX_COUNT + 1) * 4);
+    std::vector<uint8_t> actual(expected.size());
+
+    for (unsigned int f = 0; f < 5; ++f)
+    {
+        for (unsigned int count = 0; count <= MAX_COUNT; ++count)
+        {
+            unsigned int offset = count % 4;
+
+            fillRandom(&src[0], src.size() * sizeof(tBGRAPixel));
+
+            // Also check the fully transparent and opaque pixels
+            for (unsigned int i = 0; i < src.size(); i += 5)
+                src[i].a = ((i / 5) % 2 ? 0xFF : 0x00);
+
+            memset(&expected[0], 0xCD, expected.size());
+            memset(&actual[0], 0xCD, actual.size());
+
+            pReference[f](&src[offset], &expected[0], count);
+            pFunctions[f](&src[offset], &actual[0], count);
+
+            if (!same(strName, FUNCTIONS[f], count, offset, &expected[0], &actual[0], expected.size()))
+                ++nbFailures;
+        }
+    }
+}
+
+
+/**************************************** MAIN ****************************************/
+
+int main()
+{
+    tBLPKernels active = blp_getActiveKernels();
+
+    printf("Active kernels: %s\n", blp_asString(active).c_str());
+
+    // The kernels selected by the library
+    testPalette("active", blp_paletteKernels());
+    testDXT("active", blp_dxtKernels());
+    testPixelFormats("active", blp_pixelFormatKernels());
+
+#if BLP_X86_KERNELS
+    // Every table the CPU can run, since the active one hides the lower levels
+    if (active >= BLP_KERNELS_SSE2)
+    {
+        testPalette("sse2", &BLP_PALETTE_KERNELS_SSE2);
+    }
+
+    if (active >= BLP_KERNELS_SSE41)
+    {
+        testPalette("sse4.1", &BLP_PALETTE_KERNELS_SSE41);
+        testDXT("sse4.1", &BLP_DXT_KERNELS_SSE41);
+        testPixelFormats("sse4.1", &BLP_PIXEL_FORMAT_KERNELS_SSE41);
+    }
+
+    if (active >= BLP_KERNELS_AVX2)
+    {
+        testPalette("avx2", &BLP_PALETTE_KERNELS_AVX2);
+        testDXT("avx2", &BLP_DXT_KERNELS_AVX2);
+        testPixelFormats("avx2", &BLP_PIXEL_FORMAT_KERNELS_AVX2);
+    }
+
+    if (active >= BLP_KERNELS_AVX512)
+    {
+        testPalette("avx512", &BLP_PALETTE_KERNELS_AVX512);
+    }
+#endif
+
+    if (nbFailures > 0)
+        printf("%d check(s) failed\n", nbFailures);
+
+    return (nbFailures > 0 ? 1 : 0);
+}